@@ -0,0 +1,36 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The 4x4 grids the solver must accept (valid.txt) or reject (invalid.txt), shared by
+// tmsg_bench and the differential test
+
+#ifndef TMSG_CORPUS
+#define TMSG_CORPUS "bench/corpus"
+#endif
+
+// One input per line of the corpus file name; exits when the file can't be opened
+inline auto read_corpus(std::string_view name) -> std::vector<std::string>
+{
+    auto path{std::format("{}/{}", TMSG_CORPUS, name)};
+    std::ifstream in{path};
+    if (!in) {
+        std::cerr << "Cannot open " << path << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<std::string> inputs{};
+    for (std::string line; std::getline(in, line);)
+        inputs.push_back(std::move(line));
+
+    return inputs;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include "machine.hpp"
+#include "turing.hpp"
+
+// Every heap allocation in the process goes through here, so stepping can be
+// checked for allocations by sampling the counter around the hot loop.
+static std::size_t allocations{0};
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    if (auto ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+// Sweeps back and forth between two '#' markers forever, never growing the tape
+auto shuttle() -> turing_machine
+{
+    using dir = turing_machine::direction;
+
+    turing_machine tm{
+        {{"right", '1'}, {{"right", '1'}, dir::right}},
+        {{"right", '#'}, {{"left", '#'}, dir::left}},
+        {{"left", '1'}, {{"left", '1'}, dir::left}},
+        {{"left", '#'}, {{"right", '#'}, dir::right}},
+    };
+    tm.set_initial_state("left");
+    tm.set_title("shuttle");
+    return tm;
+}
+
+int main()
+{
+    constexpr std::size_t step_count{50'000'000};
+
+    machine_definition definition{shuttle()};
+    execution exec{definition};
+    auto input{"#" + std::string(64, '1') + "#"};
+
+    exec.load_input(input);
+    exec.step();
+
+    auto allocations_before{allocations};
+    auto start{std::chrono::steady_clock::now()};
+
+    for (std::size_t i = 0; i < step_count; ++i)
+        exec.step();
+
+    std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+    auto step_allocations{allocations - allocations_before};
+
+    // run() allocates only for its result, never per step,
+    // so a short and a long run must allocate the same amount
+    allocations_before = allocations;
+    exec.load_input(input);
+    exec.run(1);
+    auto short_run_allocations{allocations - allocations_before};
+
+    allocations_before = allocations;
+    exec.load_input(input);
+    auto result{exec.run(step_count)};
+    auto run_allocations{allocations - allocations_before - short_run_allocations};
+
+    std::cout << "steps:             " << step_count << '\n'
+              << "seconds:           " << elapsed.count() << '\n'
+              << "steps/sec:         " << step_count / elapsed.count() << '\n'
+              << "step allocations:  " << step_allocations << '\n'
+              << "run allocations:   " << run_allocations
+              << " (" << result.steps << " steps)" << '\n';
+
+    return step_allocations == 0 && run_allocations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "bench/corpus.hpp"
+#include "machine.hpp"
+#include "solver.hpp"
+#include "turing.hpp"
+
+// Canonical workloads: the solver main() runs, and the 4x4 grids under bench/corpus,
+// which it must accept (valid.txt) or reject (invalid.txt). Prints one JSON object,
+// each time the best of the given number of repeats, so runs of two commits compare.
+
+// Times each engine goes through the corpus per repeat, so the timings aren't noise
+constexpr std::size_t corpus_passes{32};
+
+[[noreturn]] void fail(std::string_view message)
+{
+    std::cerr << message << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+// Seconds taken by the fastest of repeats calls of work
+template<typename Work>
+auto best_of(unsigned repeats, Work&& work) -> double
+{
+    auto best{std::numeric_limits<double>::max()};
+
+    for (unsigned i = 0; i < repeats; ++i) {
+        auto start{std::chrono::steady_clock::now()};
+        work();
+        std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+auto engine_json(double seconds, std::size_t steps, std::size_t inputs) -> std::string
+{
+    return std::format(R"({{"seconds": {:.6f}, "steps_per_second": {:.0f}, "inputs_per_second": {:.0f}}})",
+        seconds, static_cast<double>(steps) / seconds, static_cast<double>(inputs) / seconds);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned repeats{5};
+    if (argc > 2 || (argc == 2 && (std::from_chars(argv[1], argv[1] + std::strlen(argv[1]), repeats).ec != std::errc{}
+            || repeats == 0)))
+        fail("Usage: ./tmsg_bench [repeats]");
+
+    using status = turing_machine::status;
+
+    auto valid{read_corpus("valid.txt")};
+    auto invalid{read_corpus("invalid.txt")};
+
+    std::vector<std::string> inputs{};
+    for (std::size_t pass = 0; pass < corpus_passes; ++pass) {
+        inputs.insert(inputs.end(), valid.begin(), valid.end());
+        inputs.insert(inputs.end(), invalid.begin(), invalid.end());
+    }
+
+    turing_machine tm{};
+    auto generate_seconds{best_of(repeats, [&] { tm = solver(); })};
+
+    std::string text{};
+    auto emit_seconds{best_of(repeats, [&] {
+        std::ostringstream out{};
+        tm.print(out);
+        text = std::move(out).str();
+    })};
+
+    auto parse_seconds{best_of(repeats, [&] { turing_machine::parse(text); })};
+
+    machine_definition definition{tm};
+    auto transitions{static_cast<std::size_t>(std::ranges::distance(tm.begin(), tm.end()))};
+
+    // The step engine's results are the reference the other engines are checked against
+    std::vector<execution::run_result> expected(inputs.size());
+    std::size_t steps{0};
+
+    auto step_seconds{best_of(repeats, [&] {
+        execution exec{definition};
+        steps = 0;
+
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            exec.load_input(inputs[i]);
+
+            auto [exec_status, input_steps] = step_until(exec, std::numeric_limits<std::size_t>::max());
+            expected[i] = {exec_status, input_steps, std::string{exec.tape()}};
+            steps += input_steps;
+        }
+    })};
+
+    for (std::size_t i = 0; i < inputs.size(); ++i)
+        if (expected[i].final_status != (i % (valid.size() + invalid.size()) < valid.size() ? status::accept : status::reject))
+            fail(std::format("Solver gives the wrong answer for {}", inputs[i]));
+
+    auto check = [&](std::string_view engine, const std::vector<execution::run_result>& results) {
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+            if (results[i].final_status != expected[i].final_status || results[i].steps != expected[i].steps
+                    || results[i].tape != expected[i].tape)
+                fail(std::format("Engine {} diverges from step() on {}", engine, inputs[i]));
+    };
+
+    std::vector<execution::run_result> results(inputs.size());
+
+    auto run_seconds{best_of(repeats, [&] {
+        execution exec{definition};
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            exec.load_input(inputs[i]);
+            results[i] = exec.run();
+        }
+    })};
+    check("run", results);
+
+    auto threads{std::max(std::thread::hardware_concurrency(), 1u)};
+    auto batch_seconds{best_of(repeats, [&] { results = run_batch(definition, inputs, threads); })};
+    check("batch", results);
+
+    std::cout << "{\n"
+        << std::format(R"(  "solver": {{"states": {}, "transitions": {}, "text_bytes": {}}},)",
+            definition.state_count(), transitions, text.size()) << '\n'
+        << std::format(R"(  "generate_seconds": {:.6f},)", generate_seconds) << '\n'
+        << std::format(R"(  "emit_seconds": {:.6f},)", emit_seconds) << '\n'
+        << std::format(R"(  "parse_seconds": {:.6f},)", parse_seconds) << '\n'
+        << std::format(R"(  "corpus": {{"valid": {}, "invalid": {}, "passes": {}, "steps": {}}},)",
+            valid.size(), invalid.size(), corpus_passes, steps) << '\n'
+        << R"(  "engines": {)" << '\n'
+        << R"(    "step": )" << engine_json(step_seconds, steps, inputs.size()) << ",\n"
+        << R"(    "run": )" << engine_json(run_seconds, steps, inputs.size()) << ",\n"
+        << R"(    "batch": )" << engine_json(batch_seconds, steps, inputs.size()) << '\n'
+        << "  },\n"
+        << std::format(R"(  "batch_threads": {},)", threads) << '\n'
+        << std::format(R"(  "repeats": {})", repeats) << '\n'
+        << "}\n";
+}
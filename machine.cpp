@@ -0,0 +1,406 @@
+#include "machine.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <ranges>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+machine_definition::machine_definition(const turing_machine& tm, compile_options options)
+    : name{tm.title},
+      blank_symbol{turing_machine::blank_symbol}
+{
+    std::unordered_map<::state_name, state_id> ids{};
+    std::string spelled{};
+    owned.name_offsets.push_back(0);
+
+    auto intern = [&](::state_name state) {
+        auto [it, inserted] = ids.try_emplace(state, static_cast<state_id>(state_total));
+        if (inserted) {
+            ++state_total;
+            spelled.clear();
+            state.append_to(spelled);
+            owned.name_chars.insert(owned.name_chars.end(), spelled.begin(), spelled.end());
+            owned.name_offsets.push_back(static_cast<std::uint32_t>(owned.name_chars.size()));
+        }
+        return it->second;
+    };
+
+    initial_id = intern(tm.initial);
+    accept_id = intern(tm.accept);
+    halt_id = intern(tm.halt_state);
+
+    auto encode = [&](char symbol) {
+        auto& code = symbol_codes[static_cast<unsigned char>(symbol)];
+        if (code == 0)
+            code = static_cast<std::uint16_t>(symbol_count++);
+    };
+
+    encode(blank_symbol);
+
+    for (const auto& [state, reaction] : tm) {
+        intern(state.first);
+        intern(reaction.first.first);
+
+        if (state.second != turing_machine::any_symbol)
+            encode(state.second);
+        if (reaction.first.second != turing_machine::same_symbol)
+            encode(reaction.first.second);
+    }
+
+    std::vector<char> code_symbols(symbol_count);
+    for (std::size_t symbol = 0; symbol < symbol_codes.size(); ++symbol)
+        if (symbol_codes[symbol] != 0)
+            code_symbols[symbol_codes[symbol]] = static_cast<char>(symbol);
+
+    owned.program.assign(state_total * symbol_count, {});
+
+    auto lower = [&](const auto& state, const auto& reaction, std::size_t code) {
+        auto write{reaction.first.second};
+
+        owned.program[ids.at(state.first) * symbol_count + code] = {
+            ids.at(reaction.first.first),
+            write == turing_machine::same_symbol ? code_symbols[code] : write,
+            reaction.second
+        };
+    };
+
+    // Wildcards first, so that explicit transitions overwrite them. Code 0 (symbols
+    // outside the alphabet) is left rejecting.
+    for (const auto& [state, reaction] : tm)
+        if (state.second == turing_machine::any_symbol)
+            for (std::size_t code = 1; code < symbol_count; ++code)
+                lower(state, reaction, code);
+
+    for (const auto& [state, reaction] : tm)
+        if (state.second != turing_machine::any_symbol)
+            lower(state, reaction, symbol_codes[static_cast<unsigned char>(state.second)]);
+
+    find_dead_states();
+    compile(code_symbols, options);
+    view_owned();
+}
+
+auto machine_definition::view_owned() -> void
+{
+    name_chars = owned.name_chars;
+    name_offsets = owned.name_offsets;
+    program = owned.program;
+    compiled_program = owned.compiled_program;
+    scans = owned.scans;
+    dead_states = owned.dead_states;
+}
+
+auto machine_definition::find_dead_states() -> void
+{
+    // Walk the transition graph backwards from the accept and halt states
+    std::vector<std::vector<state_id>> sources(state_count());
+    for (state_id state = 0; state < state_count(); ++state)
+        for (std::size_t code = 0; code < symbol_count; ++code)
+            if (auto next = owned.program[state * symbol_count + code].next; next != no_state)
+                sources[next].push_back(state);
+
+    owned.dead_states.assign(state_count(), true);
+    std::vector<state_id> pending{accept_id, halt_id};
+
+    while (!pending.empty()) {
+        auto state{pending.back()};
+        pending.pop_back();
+
+        if (!owned.dead_states[state])
+            continue;
+
+        owned.dead_states[state] = false;
+        pending.insert(pending.end(), sources[state].begin(), sources[state].end());
+    }
+}
+
+auto machine_definition::compile(std::span<const char> code_symbols, compile_options options) -> void
+{
+    owned.compiled_program.reserve(owned.program.size());
+    for (const auto& reaction : owned.program)
+        owned.compiled_program.push_back({
+            .next = reaction.next,
+            .move = static_cast<std::int32_t>(turing_machine::head_offsets[std::to_underlying(reaction.move)]),
+            .write = reaction.write
+        });
+
+    mark_scans(code_symbols);
+    fuse_chains(code_symbols);
+
+    // A fused chain passing through a dead state ends in one, so checking targets is enough
+    if (options.early_reject)
+        for (state_id state = 0; state < state_count(); ++state)
+            for (auto& reaction : std::span{owned.compiled_program}.subspan(state * symbol_count, symbol_count))
+                if (owned.dead_states[state] || (reaction.next != no_state && owned.dead_states[reaction.next]))
+                    reaction = {};
+}
+
+auto machine_definition::mark_scans(std::span<const char> code_symbols) -> void
+{
+    for (state_id state = 0; state < state_count(); ++state) {
+        if (state == accept_id || state == halt_id)
+            continue;
+
+        auto* row{owned.compiled_program.data() + state * symbol_count};
+
+        // A scan state keeps the symbol and moves the same way on every looping code
+        auto loops = [&](std::size_t code, std::int32_t move) {
+            return row[code].next == state && row[code].write == code_symbols[code] && row[code].move == move;
+        };
+
+        std::int32_t move{0};
+        for (std::size_t code = 1; code < symbol_count && move == 0; ++code)
+            if (loops(code, row[code].move))
+                move = row[code].move;
+
+        if (move == 0)
+            continue;
+
+        scan_stops scan{};
+        std::vector<char> stop_symbols{};
+        for (std::size_t symbol = 0; symbol < scan.stops.size(); ++symbol) {
+            auto code{symbol_codes[symbol]};
+            scan.stops[symbol] = code == 0 || !loops(code, move);
+            if (code != 0 && scan.stops[symbol])
+                stop_symbols.push_back(static_cast<char>(symbol));
+        }
+
+        if (stop_symbols.size() == 1) {
+            scan.needle = stop_symbols.front();
+            scan.has_needle = true;
+        }
+
+        auto index{static_cast<std::uint32_t>(owned.scans.size())};
+        owned.scans.push_back(scan);
+
+        for (std::size_t code = 1; code < symbol_count; ++code)
+            if (loops(code, move))
+                row[code].scan = index;
+    }
+}
+
+// Points reactions past the steps that follow them regardless of the tape: chains of
+// symbol-independent moves (as component::_move builds), no-op hold hops (as redirect_state,
+// component::repeat and concat's renamed accept states insert) and, after a hold, the
+// reaction to the symbol just written. The result applies the total move at once.
+auto machine_definition::fuse_chains(std::span<const char> code_symbols) -> void
+{
+    // Next state and move of states that keep every alphabet symbol and move the same way
+    std::vector<std::optional<std::pair<state_id, std::int32_t>>> uniform(state_count());
+
+    for (state_id state = 0; state < state_count() && symbol_count > 1; ++state) {
+        if (state == accept_id || state == halt_id)
+            continue;
+
+        const auto* row{owned.compiled_program.data() + state * symbol_count};
+
+        auto follows_first = [&](std::size_t code) {
+            return row[code].next == row[1].next && row[code].move == row[1].move
+                && row[code].write == code_symbols[code];
+        };
+
+        if (row[1].next != no_state && row[1].next != state
+                && std::ranges::all_of(std::views::iota(std::size_t{1}, symbol_count), follows_first))
+            uniform[state] = {row[1].next, row[1].move};
+    }
+
+    for (auto& reaction : owned.compiled_program) {
+        if (reaction.scan != no_scan)
+            continue;
+
+        // A chain longer than the state count is a cycle: leave the rest to single steps
+        while (reaction.next != no_state && reaction.next != accept_id && reaction.next != halt_id
+                && reaction.steps <= state_count()) {
+            auto hop{uniform[reaction.next]};
+
+            // Turning back would jump over cells the steps visit, and the tape must still grow over them
+            if (hop && reaction.move != 0 && hop->second != 0 && (reaction.move > 0) != (hop->second > 0))
+                break;
+
+            if (hop) {
+                reaction.next = hop->first;
+                reaction.move += hop->second;
+            } else if (reaction.move == 0) {
+                auto index{reaction.next * symbol_count + symbol_codes[static_cast<unsigned char>(reaction.write)]};
+                if (owned.program[index].next == no_state || owned.compiled_program[index].scan != no_scan)
+                    break;
+
+                reaction.next = owned.program[index].next;
+                reaction.move = static_cast<std::int32_t>(
+                    turing_machine::head_offsets[std::to_underlying(owned.program[index].move)]);
+                reaction.write = owned.program[index].write;
+            } else {
+                break;
+            }
+
+            ++reaction.steps;
+        }
+    }
+}
+
+auto machine_definition::in_alphabet(std::string_view input) const -> bool
+{
+    return std::ranges::all_of(input, [&](char symbol) {
+        return symbol_codes[static_cast<unsigned char>(symbol)] != 0;
+    });
+}
+
+auto machine_definition::alphabet() const -> std::string
+{
+    std::string symbols(symbol_count - 1, '\0');
+    for (std::size_t symbol = 0; symbol < symbol_codes.size(); ++symbol)
+        if (symbol_codes[symbol] != 0)
+            symbols[symbol_codes[symbol] - 1] = static_cast<char>(symbol);
+
+    return symbols;
+}
+
+auto machine_definition::fingerprint() const -> std::uint64_t
+{
+    // 64-bit FNV-1a; reaction padding is zeroed, so equal tables hash equal
+    std::uint64_t hash{0xcbf29ce484222325};
+    auto mix = [&](std::span<const std::byte> bytes) {
+        for (auto byte : bytes)
+            hash = (hash ^ std::to_integer<std::uint64_t>(byte)) * 0x100000001b3;
+    };
+
+    std::array<state_id, 3> states{initial_id, accept_id, halt_id};
+    mix(std::as_bytes(std::span{states}));
+    mix(std::as_bytes(std::span{symbol_codes}));
+    mix(std::as_bytes(std::span{&blank_symbol, 1}));
+    mix(std::as_bytes(name_offsets));
+    mix(std::as_bytes(name_chars));
+    mix(std::as_bytes(program));
+    return hash;
+}
+
+auto execution::load_input(std::string_view input) -> void
+{
+    current_state = definition->initial_state();
+    in_alphabet = definition->in_alphabet(input);
+    cells.load(input);
+}
+
+auto execution::step() -> status
+{
+    auto& current_symbol{cells.symbol()};
+
+    const auto& reaction = definition->lookup(current_state, current_symbol);
+    if (reaction.next == machine_definition::no_state)
+        return status::reject;
+
+    current_state = reaction.next;
+    current_symbol = reaction.write;
+    cells.move(turing_machine::head_offsets[std::to_underlying(reaction.move)]);
+
+    return current_state == definition->halt_state() ? status::halt
+        : current_state == definition->accept_state() ? status::accept
+        : status::running;
+}
+
+auto execution::run(std::size_t max_steps) -> run_result
+{
+    auto [exec, steps] = in_alphabet ? run_compiled(max_steps) : step_until(*this, max_steps);
+    return {exec, steps, std::string{tape()}};
+}
+
+// Writes only alphabet symbols, so a tape loaded in the alphabet stays in it
+auto execution::run_compiled(std::size_t max_steps) -> std::pair<status, std::size_t>
+{
+    std::size_t steps{0};
+
+    while (steps < max_steps) {
+        auto& current_symbol{cells.symbol()};
+
+        const auto& reaction = definition->compiled(current_state, current_symbol);
+        if (reaction.next == machine_definition::no_state)
+            return {status::reject, steps};
+
+        if (reaction.scan != machine_definition::no_scan) {
+            // Every cell before the stop is one looping step; past the visited region
+            // the search stops at the first blank and resumes from there
+            const auto& scan{definition->scan(reaction.scan)};
+            auto distance{scan.has_needle ? cells.distance_to(scan.needle, reaction.move)
+                                          : cells.distance_to(scan.stops, reaction.move)};
+
+            auto taken{std::min(static_cast<std::size_t>(distance), max_steps - steps)};
+            cells.move(static_cast<std::ptrdiff_t>(taken) * reaction.move);
+            steps += taken;
+            continue;
+        }
+
+        // Fused reactions that would overrun the step limit are replaced by single steps
+        if (reaction.steps > max_steps - steps) {
+            auto exec{step()};
+            if (exec == status::reject)
+                return {exec, steps};
+
+            ++steps;
+            if (exec != status::running)
+                return {exec, steps};
+
+            continue;
+        }
+
+        current_state = reaction.next;
+        current_symbol = reaction.write;
+        cells.move(reaction.move);
+        steps += reaction.steps;
+
+        if (current_state == definition->halt_state())
+            return {status::halt, steps};
+        if (current_state == definition->accept_state())
+            return {status::accept, steps};
+    }
+
+    return {status::running, steps};
+}
+
+auto execution::tape() const -> std::string_view
+{
+    return cells.contents();
+}
+
+auto distribute(std::size_t count, unsigned thread_count,
+    const std::function<std::function<void(std::size_t)>()>& make_worker) -> void
+{
+    std::atomic<std::size_t> next{0};
+
+    auto worker = [&] {
+        auto handle{make_worker()};
+
+        for (auto i = next++; i < count; i = next++)
+            handle(i);
+    };
+
+    thread_count = std::clamp<unsigned>(thread_count, 1,
+        static_cast<unsigned>(std::max<std::size_t>(count, 1)));
+
+    std::vector<std::thread> workers{};
+    for (unsigned i = 1; i < thread_count; ++i)
+        workers.emplace_back(worker);
+
+    worker();
+
+    for (auto& thread : workers)
+        thread.join();
+}
+
+auto run_batch(const machine_definition& definition, std::span<const std::string> inputs,
+    unsigned thread_count, std::size_t max_steps)
+    -> std::vector<execution::run_result>
+{
+    std::vector<execution::run_result> results(inputs.size());
+
+    distribute(inputs.size(), thread_count, [&] {
+        return [&, exec = execution{definition}](std::size_t i) mutable {
+            exec.load_input(inputs[i]);
+            results[i] = exec.run(max_steps);
+        };
+    });
+
+    return results;
+}
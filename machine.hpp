@@ -0,0 +1,264 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "mapped_file.hpp"
+#include "tape.hpp"
+#include "turing.hpp"
+
+struct compile_options {
+    // Reject as soon as a run enters a state that can reach neither the accept nor the halt
+    // state, instead of stepping until a transition is missing. Such runs report fewer steps
+    // and a shorter tape, and runs that would loop forever among those states reject; tmsg -e
+    // turns it on. This only sees the transition graph: a run doomed by a missing transition
+    // on some symbol still steps until it gets there. That is how the solver rejects, so it
+    // gains nothing there, none of its reachable states being dead.
+    bool early_reject{false};
+};
+
+// Immutable, compiled form of a turing_machine: states interned to dense IDs,
+// symbols to dense codes (0 = unknown) and the transition table lowered into
+// a flat [state_id][symbol] array. Never modified after construction, so one
+// definition can be shared by any number of executions and threads.
+class machine_definition {
+public:
+    using state_id = std::uint32_t;
+    using status = turing_machine::status;
+    using direction = turing_machine::direction;
+
+    static constexpr state_id no_state{std::numeric_limits<state_id>::max()};
+
+    // Padding is spelled out and zeroed, so saved images are the same bytes every time
+    struct reaction {
+        state_id next{no_state};
+        char write{};
+        direction move{};
+        std::array<char, 2> padding{};
+    };
+
+    static constexpr std::uint32_t no_scan{std::numeric_limits<std::uint32_t>::max()};
+
+    // Reaction of the compiled program execution::run() uses on tapes holding only alphabet
+    // symbols. A scan reaction belongs to a state that loops in place, moving one cell per step
+    // until it reads a stop symbol; run() finds that cell in one search of the tape. Other
+    // reactions may stand for several steps, whose total move they apply at once.
+    struct compiled_reaction {
+        state_id next{no_state};
+        std::int32_t move{};
+        std::uint32_t steps{1};
+        std::uint32_t scan{no_scan};
+        char write{};
+        std::array<char, 3> padding{};
+    };
+
+    // Symbols ending a scan; needle is set when exactly one alphabet symbol does
+    struct scan_stops {
+        std::array<bool, 256> stops{};
+        char needle{};
+        bool has_needle{};
+    };
+
+    explicit machine_definition(const turing_machine& tm, compile_options options = {});
+
+    // The tables are views of owned or mapped storage, so definitions move but don't copy
+    machine_definition(machine_definition&&) noexcept = default;
+    auto operator=(machine_definition&&) noexcept -> machine_definition& = default;
+    machine_definition(const machine_definition&) = delete;
+    auto operator=(const machine_definition&) -> machine_definition& = delete;
+
+    // Binary image: a versioned header (initial, accept and halt states, title, alphabet),
+    // the state name table and every table execution reads, aligned so that open() runs
+    // straight from a read-only mapping of the file. Images are only readable on machines
+    // with the byte order that wrote them. open() throws std::runtime_error on a bad image.
+    auto save(const std::filesystem::path& path) const -> void;
+    static auto is_image(std::string_view data) -> bool;
+    static auto open(mapped_file file) -> machine_definition;
+
+    // Equivalent turing_machine with one explicit transition per state and symbol
+    auto to_machine() const -> turing_machine;
+
+    // Index of the (state, symbol) entry of the transition tables, below transition_count()
+    auto transition(state_id state, char symbol) const -> std::size_t
+    {
+        return state * symbol_count + symbol_codes[static_cast<unsigned char>(symbol)];
+    }
+
+    auto transition_count() const -> std::size_t { return program.size(); }
+
+    auto lookup(state_id state, char symbol) const -> const reaction&
+    {
+        return program[transition(state, symbol)];
+    }
+
+    auto compiled(state_id state, char symbol) const -> const compiled_reaction&
+    {
+        return compiled_program[transition(state, symbol)];
+    }
+
+    auto scan(std::uint32_t index) const -> const scan_stops& { return scans[index]; }
+
+    // True for states that can reach neither the accept nor the halt state
+    auto dead(state_id state) const -> bool { return dead_states[state]; }
+
+    // True when every symbol of input is in the alphabet
+    auto in_alphabet(std::string_view input) const -> bool;
+
+    // The alphabet in code order: the symbol with code c is at c - 1
+    auto alphabet() const -> std::string;
+
+    // Hash of the state names, alphabet and base program. Definitions with equal
+    // fingerprints number their states and symbols the same way.
+    auto fingerprint() const -> std::uint64_t;
+
+    auto state_count() const -> std::size_t { return state_total; }
+    auto state_name(state_id state) const -> std::string_view
+    {
+        return {name_chars.data() + name_offsets[state], name_offsets[state + 1] - name_offsets[state]};
+    }
+
+    auto initial_state() const -> state_id { return initial_id; }
+    auto accept_state() const -> state_id { return accept_id; }
+    auto halt_state() const -> state_id { return halt_id; }
+    auto title() const -> std::string_view { return name; }
+    auto blank() const -> char { return blank_symbol; }
+
+private:
+    machine_definition() = default;
+
+    // Tables built by the constructor. Moving a vector keeps its buffer, so the views stay
+    // valid when a definition moves (a std::string may hold short contents inline).
+    struct storage {
+        std::vector<char> name_chars{};
+        std::vector<std::uint32_t> name_offsets{};
+        std::vector<reaction> program{};
+        std::vector<compiled_reaction> compiled_program{};
+        std::vector<scan_stops> scans{};
+        std::vector<std::uint8_t> dead_states{};
+    };
+
+    storage owned{};
+    std::optional<mapped_file> image{};
+
+    // What the accessors read: views of owned, or of a mapped image
+    std::span<const char> name_chars{};
+    std::span<const std::uint32_t> name_offsets{};
+    std::span<const reaction> program{};
+    std::span<const compiled_reaction> compiled_program{};
+    std::span<const scan_stops> scans{};
+    std::span<const std::uint8_t> dead_states{};
+
+    std::size_t state_total{0};
+    std::array<std::uint16_t, 256> symbol_codes{};
+    std::size_t symbol_count{1};
+
+    state_id initial_id{no_state};
+    state_id accept_id{no_state};
+    state_id halt_id{no_state};
+    std::string name{};
+    char blank_symbol{};
+
+    auto compile(std::span<const char> code_symbols, compile_options options) -> void;
+    auto mark_scans(std::span<const char> code_symbols) -> void;
+    auto fuse_chains(std::span<const char> code_symbols) -> void;
+    auto find_dead_states() -> void;
+    auto view_owned() -> void;
+};
+
+// Runtime state of one input on a machine_definition: the tape and the current
+// state. Cheap to create; the definition must outlive it.
+class execution {
+public:
+    using status = turing_machine::status;
+    using state_id = machine_definition::state_id;
+
+    struct run_result {
+        status final_status;
+        std::size_t steps;
+        std::string tape;
+    };
+
+    explicit execution(const machine_definition& definition)
+        : definition{&definition},
+          cells{definition.blank()}
+    {
+    }
+
+    auto load_input(std::string_view input) -> void;
+    auto step() -> status;
+
+    // Runs the loaded input to completion (or until max_steps) without building any per-step output.
+    // Uses the compiled program when the input is in the alphabet; steps still count single moves.
+    auto run(std::size_t max_steps = std::numeric_limits<std::size_t>::max()) -> run_result;
+
+    auto tape() const -> std::string_view;
+    auto head_position() const -> std::size_t { return cells.head_position(); }
+    auto machine() const -> const machine_definition& { return *definition; }
+    auto state() const -> state_id { return current_state; }
+    auto symbol() const -> char { return cells.symbol(); }
+
+private:
+    const machine_definition* definition;
+    tape_buffer cells;
+    state_id current_state{machine_definition::no_state};
+    bool in_alphabet{false};
+
+    auto run_compiled(std::size_t max_steps) -> std::pair<status, std::size_t>;
+};
+
+// The step loop of every engine: steps exec until the run stops or has taken max_steps
+// steps, and returns the final status and the steps taken. A missing transition rejects
+// without taking a step. After each step taken, on_step(state, symbol) gets the state and
+// symbol it read. Any engine with the step(), state() and symbol() of execution will do.
+template<typename Execution, typename OnStep>
+auto step_until(Execution& exec, std::size_t max_steps, OnStep&& on_step)
+    -> std::pair<turing_machine::status, std::size_t>
+{
+    auto exec_status{turing_machine::status::running};
+    std::size_t steps{0};
+
+    while (steps < max_steps) {
+        auto state{exec.state()};
+        auto symbol{exec.symbol()};
+
+        exec_status = exec.step();
+        if (exec_status == turing_machine::status::reject)
+            break;
+
+        ++steps;
+        on_step(state, symbol);
+
+        if (exec_status != turing_machine::status::running)
+            break;
+    }
+
+    return {exec_status, steps};
+}
+
+template<typename Execution>
+auto step_until(Execution& exec, std::size_t max_steps) -> std::pair<turing_machine::status, std::size_t>
+{
+    return step_until(exec, max_steps, [](const auto&, char) {});
+}
+
+// Hands out the indices [0, count) to thread_count threads. make_worker() is called once
+// on each thread and returns that thread's handler, so handlers can own per-thread state.
+auto distribute(std::size_t count, unsigned thread_count,
+    const std::function<std::function<void(std::size_t)>()>& make_worker) -> void;
+
+// Runs every input on thread_count workers, each with its own execution of the
+// shared definition. Results are in input order.
+auto run_batch(const machine_definition& definition, std::span<const std::string> inputs,
+    unsigned thread_count, std::size_t max_steps = std::numeric_limits<std::size_t>::max())
+    -> std::vector<execution::run_result>;
+
+#endif
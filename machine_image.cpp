@@ -0,0 +1,206 @@
+#include "machine.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+    constexpr std::array<char, 8> image_magic{'T', 'M', 'S', 'G', 'I', 'M', 'G', '\0'};
+    constexpr std::uint32_t image_version{1};
+    constexpr std::uint32_t byte_order_mark{0x01020304};
+    constexpr std::size_t section_alignment{8};
+
+    struct section {
+        std::uint64_t offset;
+        std::uint64_t size;
+    };
+
+    // Start of every image; the sections it locates follow it, each aligned to section_alignment
+    struct image_header {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint32_t state_count;
+        std::uint32_t symbol_count;
+        std::uint32_t initial;
+        std::uint32_t accept;
+        std::uint32_t halt;
+        char blank;
+        std::array<std::uint16_t, 256> symbol_codes;
+        section title;
+        section name_offsets;
+        section name_chars;
+        section program;
+        section compiled_program;
+        section scans;
+        section dead_states;
+    };
+
+    static_assert(std::is_trivially_copyable_v<image_header>);
+    static_assert(std::has_unique_object_representations_v<machine_definition::reaction>
+        && std::has_unique_object_representations_v<machine_definition::compiled_reaction>
+        && std::has_unique_object_representations_v<machine_definition::scan_stops>);
+    static_assert(sizeof(image_header) % section_alignment == 0);
+
+    [[noreturn]] auto corrupt() -> void
+    {
+        throw std::runtime_error("Corrupt machine image");
+    }
+
+    // count elements of T at place, checked against the image bounds and alignment
+    template<typename T>
+    auto section_view(std::string_view image, section place, std::size_t count) -> std::span<const T>
+    {
+        static_assert(std::is_trivially_copyable_v<T> && section_alignment % alignof(T) == 0);
+
+        if (place.offset % section_alignment != 0 || place.offset > image.size()
+                || place.size > image.size() - place.offset || place.size != count * sizeof(T))
+            corrupt();
+
+        return {reinterpret_cast<const T*>(image.data() + place.offset), count};
+    }
+}
+
+auto machine_definition::save(const std::filesystem::path& path) const -> void
+{
+    // Zeroed so the padding bytes are deterministic too
+    image_header header;
+    std::memset(&header, 0, sizeof header);
+
+    header.magic = image_magic;
+    header.version = image_version;
+    header.byte_order = byte_order_mark;
+    header.state_count = static_cast<std::uint32_t>(state_total);
+    header.symbol_count = static_cast<std::uint32_t>(symbol_count);
+    header.initial = initial_id;
+    header.accept = accept_id;
+    header.halt = halt_id;
+    header.blank = blank_symbol;
+    header.symbol_codes = symbol_codes;
+
+    std::string body{};
+
+    auto append = [&]<typename T>(std::span<const T> data) -> section {
+        body.resize((body.size() + section_alignment - 1) / section_alignment * section_alignment);
+
+        auto bytes{std::as_bytes(data)};
+        section place{sizeof header + body.size(), bytes.size()};
+        body.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        return place;
+    };
+
+    header.title = append(std::span{name});
+    header.name_offsets = append(name_offsets);
+    header.name_chars = append(name_chars);
+    header.program = append(program);
+    header.compiled_program = append(compiled_program);
+    header.scans = append(scans);
+    header.dead_states = append(dead_states);
+
+    std::ofstream out{path, std::ios::binary};
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+    out.write(body.data(), static_cast<std::streamsize>(body.size()));
+
+    if (!out)
+        throw std::runtime_error("Can't write machine image " + path.string());
+}
+
+auto machine_definition::is_image(std::string_view data) -> bool
+{
+    return data.size() >= sizeof(image_header)
+        && std::memcmp(data.data(), image_magic.data(), image_magic.size()) == 0;
+}
+
+auto machine_definition::open(mapped_file file) -> machine_definition
+{
+    auto data{file.view()};
+    if (!is_image(data))
+        throw std::runtime_error("Not a machine image");
+
+    image_header header;
+    std::memcpy(&header, data.data(), sizeof header);
+
+    if (header.version != image_version || header.byte_order != byte_order_mark)
+        throw std::runtime_error("Unsupported machine image version or byte order");
+
+    auto states{std::size_t{header.state_count}};
+    if (header.symbol_count == 0 || header.symbol_count > 257 || header.initial >= states
+            || header.accept >= states || header.halt >= states)
+        corrupt();
+
+    machine_definition definition{};
+    definition.state_total = states;
+    definition.symbol_count = header.symbol_count;
+    definition.symbol_codes = header.symbol_codes;
+    definition.initial_id = header.initial;
+    definition.accept_id = header.accept;
+    definition.halt_id = header.halt;
+    definition.blank_symbol = header.blank;
+
+    auto title{section_view<char>(data, header.title, header.title.size)};
+    definition.name.assign(title.begin(), title.end());
+
+    // The tables themselves are used in place
+    auto cells{states * header.symbol_count};
+    definition.name_offsets = section_view<std::uint32_t>(data, header.name_offsets, states + 1);
+    definition.name_chars = section_view<char>(data, header.name_chars, definition.name_offsets.back());
+    definition.program = section_view<reaction>(data, header.program, cells);
+    definition.compiled_program = section_view<compiled_reaction>(data, header.compiled_program, cells);
+    definition.scans = section_view<scan_stops>(data, header.scans, header.scans.size / sizeof(scan_stops));
+    definition.dead_states = section_view<std::uint8_t>(data, header.dead_states, states);
+
+    if (!std::ranges::is_sorted(definition.name_offsets))
+        corrupt();
+
+    // Execution indexes with these without checking
+    auto known = [&](state_id state) { return state == no_state || state < states; };
+
+    if (std::ranges::any_of(definition.symbol_codes, [&](auto code) { return code >= header.symbol_count; }))
+        corrupt();
+
+    for (const auto& reaction : definition.program)
+        if (!known(reaction.next) || std::to_underlying(reaction.move) > std::to_underlying(direction::hold))
+            corrupt();
+
+    // Each step moves the head at most one cell, and a scan exactly one cell per step
+    for (const auto& reaction : definition.compiled_program) {
+        auto distance{static_cast<std::uint64_t>(std::abs(static_cast<std::int64_t>(reaction.move)))};
+
+        if (!known(reaction.next) || reaction.steps == 0 || distance > reaction.steps
+                || (reaction.scan != no_scan && (reaction.scan >= definition.scans.size() || distance != 1)))
+            corrupt();
+    }
+
+    definition.image = std::move(file);
+    return definition;
+}
+
+auto machine_definition::to_machine() const -> turing_machine
+{
+    std::vector<char> code_symbols(symbol_count);
+    for (std::size_t symbol = 0; symbol < symbol_codes.size(); ++symbol)
+        if (symbol_codes[symbol] != 0)
+            code_symbols[symbol_codes[symbol]] = static_cast<char>(symbol);
+
+    turing_machine tm{};
+    tm.transitions.reserve(program.size());
+
+    for (state_id state = 0; state < state_total; ++state)
+        for (std::size_t code = 1; code < symbol_count; ++code) {
+            const auto& reaction{program[state * symbol_count + code]};
+            if (reaction.next == no_state)
+                continue;
+
+            tm.transitions.try_emplace({::state_name{state_name(state)}, code_symbols[code]},
+                turing_machine::tape_reaction{{::state_name{state_name(reaction.next)}, reaction.write}, reaction.move});
+        }
+
+    tm.initial = state_name(initial_id);
+    tm.accept = state_name(accept_id);
+    tm.halt_state = state_name(halt_id);
+    tm.title = name;
+    return tm;
+}
@@ -1,13 +1,19 @@
-#include <__ranges/repeat_view.h>
 #include <algorithm>
-#include <concepts>
-#include <initializer_list>
+#include <charconv>
+#include <fstream>
 #include <iostream>
-#include <iterator>
-#include <ranges>
+#include <limits>
+#include <optional>
+#include <thread>
 #include <string>
 #include <string_view>
 #include <vector>
+#include "machine.hpp"
+#include "mapped_file.hpp"
+#include "profile.hpp"
+#include "recorder.hpp"
+#include "solver.hpp"
+#include "trace.hpp"
 #include "turing.hpp"
 
 using namespace std::literals;
@@ -18,440 +24,273 @@ using namespace std::literals;
     std::exit(EXIT_FAILURE);
 }
 
-auto ansi_blue{"\033[1;34m"sv};
-auto ansi_reset{"\033[0m"sv};
-
-void run_input(turing_machine& tm, std::string_view input)
+void run_input(const machine_definition& definition, std::string_view input, trace_options options,
+    std::size_t max_steps)
 {
-    auto print_tm_state = [](const auto& tm)
-    {
-        std::cout << tm.head() << std::endl
-            << ansi_blue << tm.tape() << ansi_reset << std::endl << std::endl;
-    };
+    execution exec{definition};
+    exec.load_input(input);
 
-    tm.load_input(input);
-    print_tm_state(tm);
+    trace_renderer trace{std::cout, options};
+    trace.frame(exec, 0, true);
 
     turing_machine::status status{};
+    std::size_t step{0};
     do {
-        status = tm.step();
-        print_tm_state(tm);
-    } while (status == turing_machine::status::running);
+        status = exec.step();
+        ++step;
+        trace.frame(exec, step, status != turing_machine::status::running || step == max_steps);
+    } while (status == turing_machine::status::running && step < max_steps);
 
-    std::cout << turing_machine::status_message(status) << std::endl;
+    trace.line(turing_machine::status_message(status));
 }
 
-turing_machine read_tm(std::istream& in)
+void run_recorded(const machine_definition& definition, std::string_view input, std::string_view path,
+    std::size_t max_steps)
 {
-    turing_machine tm{};
+    execution exec{definition};
+    exec.load_input(input);
 
     try {
-        in >> tm;
+        step_recorder recorder{path, definition, input};
+        auto status{record_run(exec, recorder, max_steps).first};
+        std::cout << turing_machine::status_message(status) << '\n';
     } catch (std::exception const& exception) {
         terminate_message(exception.what());
     }
-
-    return tm;
 }
 
-
-namespace component {
-    using dir = turing_machine::direction;
-    const auto alphabet{"1234:#_"sv | std::ranges::to<std::set>()};
-
-    auto _move(int amount, std::string_view name, dir direction)
-        -> turing_machine
-    {
-        auto build_transition = [direction](const auto symbol)
-        {
-            return [direction, symbol](const auto idx) -> turing_machine::transition_entry
-            {
-                return {
-                     {std::to_string(idx), symbol},
-                    {{std::to_string(idx+1), symbol}, direction}
-                };
-            };
-        };
-
-        turing_machine tm {};
-        tm.set_initial_state(std::to_string(0));
-        tm.set_accept_state(std::to_string(amount));
-
-        for (const auto symbol : alphabet) {
-            tm.add_transitions(
-                std::views::iota(0)
-                | std::views::take(amount)
-                | std::views::transform(build_transition(symbol))
-            );
-        }
-        
-        tm.set_title(name);
-        return tm;
+void print_recorded(const machine_definition& definition, std::string_view path)
+{
+    try {
+        mapped_file file{path};
+        print_trace(std::cout, definition, recorded_trace::read(file.view()));
+    } catch (std::exception const& exception) {
+        terminate_message(exception.what());
     }
+}
 
-    auto move_right(int amount, std::string_view name)
-        -> turing_machine
-    {
-        return _move(amount, name, dir::right);
-    }
+void run_quiet(const machine_definition& definition, std::string_view input, std::size_t max_steps)
+{
+    execution exec{definition};
+    exec.load_input(input);
 
-    auto move_left(int amount, std::string_view name)
-        -> turing_machine
-    {
-        return _move(amount, name, dir::left);
-    }
+    auto result{exec.run(max_steps)};
+    std::cout << turing_machine::status_message(result.final_status) << '\n';
+}
 
-    auto find(char needle, std::string_view name, dir direction)
-        -> turing_machine
-    {
-        turing_machine tm {};
-        tm.set_initial_state("search");
+// The wildcard isn't a tape symbol, so an input holding it is a mistake rather than a reject
+void check_input(std::string_view input)
+{
+    if (input.contains(turing_machine::any_symbol))
+        terminate_message(std::format("Input can't contain the wildcard '{}': {}", turing_machine::any_symbol, input));
+}
 
-        for (const auto symbol : alphabet) {
-            auto is_needle{symbol == needle};
+turing_machine read_tm(std::istream& in)
+{
+    turing_machine tm{};
 
-            tm.add_transition(
-                {"search", symbol},
-                {{is_needle ? tm.accept_state() : "search", symbol},
-                    is_needle ? dir::hold : direction}
-            );
-        }
-        
-        tm.set_title(name);
-        return tm;
+    try {
+        in >> tm;
+    } catch (std::exception const& exception) {
+        terminate_message(exception.what());
     }
 
-    auto find_right(char needle, std::string_view name)
-        -> turing_machine
-    {
-        return find(needle, name, dir::right);
-    }
+    return tm;
+}
 
-    auto find_left(char needle, std::string_view name)
-        -> turing_machine
-    {
-        return find(needle, name, dir::left);
+auto read_inputs(std::istream& in) -> std::vector<std::string>
+{
+    std::vector<std::string> inputs{};
+    for (std::string line; std::getline(in, line);) {
+        check_input(line);
+        inputs.push_back(std::move(line));
     }
 
-    enum class repeater {
-        do_until,
-        do_while
-    };
+    return inputs;
+}
 
-    auto repeat(const turing_machine& tm, repeater type, char symbol, std::string_view name)
-        -> turing_machine
-    {
-        // Start with prefixed renamed version of tm
-        auto repeater{turing_machine::concat(
-            turing_machine::list{tm}, name)
-        };
+void run_inputs(const machine_definition& definition, std::istream& in, unsigned thread_count, std::size_t max_steps)
+{
+    auto inputs{read_inputs(in)};
 
-        auto checker_state{"check"};
-        auto break_state{"break"};
+    std::string report{};
+    for (const auto& result : run_batch(definition, inputs, thread_count, max_steps))
+        report.append(turing_machine::status_message(result.final_status)).push_back('\n');
 
-        // Redirect accept -> check
-        repeater.redirect_state(repeater.accept_state(), checker_state, alphabet);
+    std::cout << report;
+}
 
-        // Redirect check -> initial [do_until] or break out [do_while]
-        repeater.redirect_state(checker_state,
-            type == repeater::do_until ? repeater.initial_state()
-                : break_state,
-            alphabet
-        );
+void profile_inputs(const machine_definition& definition, std::istream& in, unsigned thread_count,
+    std::size_t max_steps, bool folded)
+{
+    auto profile{profile_batch(definition, read_inputs(in), thread_count, max_steps)};
 
-        // ...but (check, needle) -> break out [do_until] or continue [do_while]
-        repeater.add_transition({checker_state, symbol}, {{
-            type == repeater::do_until ? break_state
-                : repeater.initial_state(),
-            symbol
-        }, dir::hold});
-        repeater.set_accept_state(break_state);
+    if (folded)
+        print_folded(std::cout, profile);
+    else
+        print_report(std::cout, profile);
+}
 
-        return repeater;
-    }
+// Step limit of batch runs without -l: thousands of times what a solver grid takes, and
+// small enough that an input that never stops can't exhaust memory and end the batch
+constexpr std::size_t batch_step_limit{10'000'000};
+
+constexpr auto usage{
+    "Usage: ./tms [-m <machine>] [-l <steps>] [-w <cells>] [-n <steps> | -s] [input]\n"
+    "       ./tms [-m <machine>] [-l <steps>] [-e] -q <input>\n"
+    "       ./tms [-m <machine>] [-l <steps>] [-e] -b <file|-> [threads]\n"
+    "       ./tms [-m <machine>] [-l <steps>] -r <file|-> [threads]\n"
+    "       ./tms [-m <machine>] [-l <steps>] -f <file|-> [threads]\n"
+    "       ./tms [-m <machine>] [-e] -i <image>\n"
+    "       ./tms [-m <machine>] [-l <steps>] -t <trace> <input>\n"
+    "       ./tms [-m <machine>] -p <trace>"sv
+};
 
-    auto first_chars = [](const auto& seq, int n)
-    {
-        return seq | std::views::take(n);
-    };
-
-    auto last_symbol = [](auto seq)
-    {
-        return *(seq | std::views::reverse).begin();
-    };
+int main(int argc, char* argv[]) {
+    std::vector<std::string_view> args{argv + 1, argv + argc};
 
-    auto to_string = [](auto seq)
-    {
-        return seq | std::ranges::to<std::string>();
+    auto count = [](std::string_view text, auto& value, unsigned minimum) {
+        auto [ptr, error] = std::from_chars(text.begin(), text.end(), value);
+        if (error != std::errc{} || ptr != text.end() || value < minimum)
+            terminate_message(usage);
     };
 
-    auto consume(char symbol, dir direction, std::string_view name)
-        -> turing_machine
-    {
-        turing_machine tm{};
-        tm.set_initial_state("consume");
-        tm.add_transition({tm.initial_state(), symbol}, {{tm.accept_state(), symbol}, direction});
-        tm.set_title(name);
-        return tm;
-    }
-
-    template<std::ranges::forward_range R, std::ranges::forward_range Q>
-    requires std::convertible_to<std::ranges::range_reference_t<R>, char>
-        && std::convertible_to<std::ranges::range_reference_t<Q>, int>
-    auto expect(R sequence, dir direction, Q distances, std::string_view name)
-        -> turing_machine
-    {
-        auto seq_len{std::ranges::distance(sequence)};
-
-        auto drop_last = [](const std::ranges::forward_range auto range)
-        {
-            return range | std::views::reverse | std::views::drop(1) | std::views::reverse;
-        };
-
-        auto carrier_name = [&](const std::ranges::forward_range auto expect)
-        {
-            return expect.size() == 1 ? "start"s : to_string(drop_last(expect));
-        };
-
-        auto nth_expect_distance = [&](const auto n)
-        {
-            return *std::ranges::next(distances.begin(), n-2);
-        };
-
-        auto build_carrier = [&](std::string expect)
-        {
-            auto len{std::ranges::distance(expect)};
-
-            turing_machine::list carrier_parts{
-                consume(last_symbol(expect), direction, "check"),
-            };
-
-            auto distance{nth_expect_distance(len)};
-            if (distance > 1)
-                carrier_parts.push_front(_move(distance-1, "shift", direction));
-
-            return turing_machine::concat(carrier_parts, carrier_name(expect));
-        };
-
+    // Machine file to run instead of the solver (as text or as an image), the most steps
+    // any run takes before it's reported as still running, compile and trace options
+    std::optional<std::string_view> machine_path{};
+    std::optional<std::size_t> step_limit{};
+    compile_options options{};
+    trace_options trace{};
+    auto traced{false};
+
+    while (!args.empty()) {
+        if (args.front() == "-s" || args.front() == "-e") {
+            if (args.front() == "-s")
+                trace.state_changes = traced = true;
+            else
+                options.early_reject = true;
+
+            args.erase(args.begin());
+            continue;
+        }
 
-        auto carrier_subseqs_lengths{
-            std::views::iota(2)
-            | std::views::take(seq_len-1)
-        };
+        if (args.size() < 2 || (args.front() != "-m" && args.front() != "-l" && args.front() != "-w"
+                && args.front() != "-n"))
+            break;
+
+        if (args.front() == "-m") {
+            machine_path = args[1];
+        } else if (args.front() == "-l") {
+            count(args[1], step_limit.emplace(), 1);
+        } else if (args.front() == "-w") {
+            count(args[1], trace.window, 0);
+            traced = true;
+        } else {
+            count(args[1], trace.every, 1);
+            traced = true;
+        }
 
-        // Map n-subsequences to carriers
-        auto carriers{
-            carrier_subseqs_lengths
-            | std::views::transform([&](const auto len) {
-                return build_carrier(to_string(first_chars(sequence, len)));
-            })
-            | std::ranges::to<turing_machine::list>()
-        };
+        args.erase(args.begin(), args.begin() + 2);
+    }
 
-        // Map start (0-subsequence) to 1-subsequence
-        auto first_subseq{first_chars(sequence, 1)};
-        carriers.push_front(consume(last_symbol(first_subseq), direction, carrier_name(first_subseq)));
+    auto flag{!args.empty() && args.front().starts_with('-') ? args.front() : ""sv};
+    if (!flag.empty())
+        args.erase(args.begin());
 
-        auto expecter{turing_machine::concat(carriers, name)};
-        expecter.redirect_state(expecter.accept_state(), "Y", alphabet);
-        expecter.set_accept_state("Y");
-        return expecter;
-    }
+    auto thread_count{std::max(std::thread::hardware_concurrency(), 1u)};
 
-    constexpr auto permutations_sequence()
-        -> std::vector<std::vector<char>>
-    {
-        std::vector<char> set{'1', '2', '3', '4'};
-        std::vector<std::vector<char>> sequences{};
-        
-        do sequences.push_back(set);
-        while (std::ranges::next_permutation(set).found);
+    auto batch{flag == "-b" || flag == "-r" || flag == "-f"};
+    auto max_steps{step_limit.value_or(batch ? batch_step_limit : std::numeric_limits<std::size_t>::max())};
 
-        return sequences;
+    if (batch && args.size() == 2) {
+        count(args[1], thread_count, 1);
+    } else if (flag == "-t" ? args.size() != 2
+            : batch || flag == "-q" || flag == "-i" || flag == "-p" ? args.size() != 1
+            : !flag.empty() || args.size() > 1) {
+        terminate_message(usage);
     }
 
-    auto check_row(std::string_view name)
-        -> turing_machine
-    {
-        auto perm{permutations_sequence()};
-        return turing_machine::union_all(perm | std::views::transform([&](const auto& seq) {
-            return expect(seq, dir::right, std::views::repeat(1), name);
-        }), name);
-    }
+    if (traced && (!flag.empty() || args.empty()))
+        terminate_message(usage);
 
-    auto check_rows(std::string_view name)
-        -> turing_machine
-    {
-        return turing_machine::concat(
-            turing_machine::list{
-                find_right(':', "move_to_row1:"),
-
-                repeat(turing_machine::concat(
-                    turing_machine::list{
-                        consume(':', dir::right, "pass:"),
-                        check_row("check_row"),
-                        move_right(4, "move_to_next")        
-                    }, "loop_body"
-                ), repeater::do_while, ':', "row_loop"),
-
-                find_left('_', "move_back"),
-                consume('_', dir::right, "move_to_start")
-            }, name
-        );
-    }
+    // Early rejection changes the steps and tape of rejected runs, so it's only for the
+    // modes that report nothing but the status, and for images, which keep it
+    if (options.early_reject && flag != "-q" && flag != "-b" && flag != "-i")
+        terminate_message(usage);
 
-    auto check_col(std::string_view name)
-        -> turing_machine
-    {
-        auto perm{permutations_sequence()};
-        return turing_machine::union_all(perm | std::views::transform([&](const auto& seq) {
-            return expect(seq, dir::right, std::views::repeat(9), name);
-        }), name);
-    }
+    if (flag.empty() || flag == "-q")
+        std::ranges::for_each(args, check_input);
+    else if (flag == "-t")
+        check_input(args[1]);
 
-    auto check_cols(std::string_view name)
-        -> turing_machine
-    {
-        return turing_machine::concat(
-            turing_machine::list{
-                find_right(':', "move_to_col1:"),
-                consume(':', dir::right, "pass:"),
-
-                repeat(turing_machine::concat(
-                    turing_machine::list{
-                        check_col("check_col"),
-                        move_left(27, "move_to_next")        
-                    }, "loop_body"
-                ), repeater::do_until, ':', "col_loop"),
-
-                find_left('_', "move_back"),
-                consume('_', dir::right, "move_to_start")
-            }, name
-        );
-    }
+    std::optional<turing_machine> tm{};
+    std::optional<mapped_file> image{};
 
-    constexpr auto tower_sequence()
-        -> std::vector<std::vector<char>>
-    {
-        std::vector<char> set{'1', '2', '3', '4'};
-        std::vector<std::vector<char>> sequences{};
-        
-        for (const auto tower : std::views::iota(1) | std::views::take(4)) {
-            do {
-                char max_height{0};
-                int towers_visible{0};
-                for (const auto height : set)
-                    if (height > max_height)
-                        max_height = height, towers_visible++;
-                
-                char tower_symbol{static_cast<char>('0' + tower)};
-
-                if (towers_visible == tower) {
-                    sequences.push_back({tower_symbol, set[0], set[1], set[2]});
-                }
-            } while (std::ranges::next_permutation(set).found);
+    try {
+        if (!machine_path) {
+            tm = solver();
+        } else if (mapped_file file{*machine_path}; machine_definition::is_image(file.view())) {
+            image = std::move(file);
+        } else {
+            tm = turing_machine::parse(file.view());
         }
+    } catch (std::exception const& exception) {
+        terminate_message(exception.what());
+    }
 
-        return sequences;
+    // Printed machines are sorted, so dumps of equal machines compare equal
+    if (tm && flag.empty() && args.empty()) {
+        tm->print(std::cout, turing_machine::ordering::canonical);
+        return 0;
     }
 
-    enum class row_tower {
-        left,
-        right
-    };
+    // Images run as they were compiled
+    if (image && options.early_reject)
+        terminate_message("Early rejection is compiled into an image, so -e only applies to text machines");
 
-    auto tower_row(row_tower tower, std::string_view name)
-        -> turing_machine
-    {
-        auto tower_seq{tower_sequence()};
-        auto expect_dir{tower == row_tower::left ? dir::right : dir::left};
-
-        return turing_machine::union_all(tower_seq
-            | std::views::transform([&](const auto& seq) {
-                return expect(seq, expect_dir, std::vector{2, 1, 1}, name);
-            }
-        ), name);
-    }
+    std::optional<machine_definition> definition{};
 
-    auto towers_rows(std::string_view name)
-        -> turing_machine
-    {
-        return turing_machine::concat(
-            turing_machine::list{
-                find_right(':', "move_to_tower1:"),
-
-                repeat(turing_machine::concat(
-                    turing_machine::list{
-                        move_left(1, "pass:"),
-                        tower_row(row_tower::left, "tower_left"),
-                        move_right(2, "move_to_right_tower"),
-                        tower_row(row_tower::right, "tower_right"),
-                        move_right(8, "move_to_next"),
-                    }, "loop_body"
-                ), repeater::do_while, ':', "tower_loop"),
-
-                find_left('_', "move_back"),
-                consume('_', dir::right, "move_to_start")
-            }, name
-        );
+    try {
+        if (tm)
+            definition.emplace(*tm, options);
+        else
+            definition = machine_definition::open(std::move(*image));
+    } catch (std::exception const& exception) {
+        terminate_message(exception.what());
     }
 
-    enum class col_tower {
-        down,
-        up
-    };
+    if (flag.empty() && args.empty()) {
+        definition->to_machine().print(std::cout, turing_machine::ordering::canonical);
+    } else if (flag == "-i") {
+        try {
+            definition->save(args.front());
+        } catch (std::exception const& exception) {
+            terminate_message(exception.what());
+        }
+    } else if (batch) {
+        auto process = [&](std::istream& in) {
+            if (flag == "-b")
+                run_inputs(*definition, in, thread_count, max_steps);
+            else
+                profile_inputs(*definition, in, thread_count, max_steps, flag == "-f");
+        };
 
-    auto tower_col(col_tower tower, std::string_view name)
-        -> turing_machine
-    {
-        auto tower_seq{tower_sequence()};
-        auto expect_dir{tower == col_tower::up ? dir::right : dir::left};
-
-        return turing_machine::union_all(tower_seq
-            | std::views::transform([&](const auto& seq) {
-                return expect(seq, expect_dir, std::vector{7, 9, 9}, name);
-            }
-        ), name);
-    }
+        if (args.front() == "-") {
+            process(std::cin);
+        } else {
+            std::ifstream file{std::string{args.front()}};
+            if (!file)
+                terminate_message(std::format("Cannot open {}", args.front()));
 
-    auto towers_cols(std::string_view name)
-        -> turing_machine
-    {
-        return turing_machine::concat(
-            turing_machine::list{
-                repeat(turing_machine::concat(
-                    turing_machine::list{
-                        tower_col(col_tower::up, "tower_up"),
-                        move_right(15, "move_to_down"),
-                        tower_col(col_tower::down, "tower_down"),
-                        move_left(14, "move_to_next")
-                    }, "loop_body"
-                ), repeater::do_until, '#', "tower_loop"),
-
-                find_left('_', "move_back"),
-                consume('_', dir::right, "move_to_start")
-            }, name
-        );
+            process(file);
+        }
+    } else if (flag == "-q") {
+        run_quiet(*definition, args.front(), max_steps);
+    } else if (flag == "-t") {
+        run_recorded(*definition, args[1], args.front(), max_steps);
+    } else if (flag == "-p") {
+        print_recorded(*definition, args.front());
+    } else {
+        run_input(*definition, args.front(), trace, max_steps);
     }
 }
-
-int main(int argc, char* argv[]) {
-    if (argc > 2)
-        terminate_message("Usage: ./tms [input]");
-
-    auto tm_final{turing_machine::concat(
-        turing_machine::list{
-            component::check_rows("check_rows"),
-            component::check_cols("check_cols"),
-            component::towers_rows("towers_rows"),
-            component::towers_cols("towers_cols")
-        }, "solver"
-    )};
-
-    tm_final.redirect_state(tm_final.accept_state(), "Y", component::alphabet);
-
-    if (argc == 1)
-        std::cout << tm_final;
-    else
-        run_input(tm_final, argv[1]);
-}
@@ -0,0 +1,66 @@
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::mapped_file(const std::filesystem::path& path)
+{
+    auto fail = [&] { throw std::system_error{errno, std::generic_category(), path.string()}; };
+
+    auto descriptor{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (descriptor < 0)
+        fail();
+
+    struct stat status{};
+    if (::fstat(descriptor, &status) < 0) {
+        auto error{errno};
+        ::close(descriptor);
+        errno = error;
+        fail();
+    }
+
+    // Pipes and devices report no size, so they would read as empty
+    if (!S_ISREG(status.st_mode)) {
+        ::close(descriptor);
+        throw std::runtime_error{path.string() + " is not a regular file"};
+    }
+
+    length = static_cast<std::size_t>(status.st_size);
+
+    // mmap() rejects empty mappings
+    void* mapping{length == 0 ? nullptr : ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0)};
+    auto error{errno};
+    ::close(descriptor);
+
+    if (mapping == MAP_FAILED) {
+        errno = error;
+        fail();
+    }
+
+    address = static_cast<const char*>(mapping);
+}
+
+mapped_file::~mapped_file()
+{
+    if (address)
+        ::munmap(const_cast<char*>(address), length);
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+    : address{std::exchange(other.address, nullptr)},
+      length{std::exchange(other.length, 0)}
+{
+}
+
+auto mapped_file::operator=(mapped_file&& other) noexcept -> mapped_file&
+{
+    std::swap(address, other.address);
+    std::swap(length, other.length);
+    return *this;
+}
@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+// Read-only memory mapping of a whole regular file. Throws std::system_error when the
+// file can't be opened or mapped, and std::runtime_error for pipes, devices and other
+// files that can't be mapped; an empty file maps to an empty view.
+class mapped_file {
+public:
+    explicit mapped_file(const std::filesystem::path& path);
+    ~mapped_file();
+
+    mapped_file(mapped_file&& other) noexcept;
+    auto operator=(mapped_file&& other) noexcept -> mapped_file&;
+
+    mapped_file(const mapped_file&) = delete;
+    auto operator=(const mapped_file&) -> mapped_file& = delete;
+
+    auto data() const -> const char* { return address; }
+    auto size() const -> std::size_t { return length; }
+    auto view() const -> std::string_view { return {address, length}; }
+
+private:
+    const char* address{nullptr};
+    std::size_t length{0};
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "profile.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <format>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <ranges>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+    constexpr std::size_t report_rows{25};
+
+    // Ends of the [segment] prefixes of name: name.substr(0, end) is the component
+    auto segment_ends(std::string_view name) -> std::vector<std::size_t>
+    {
+        std::vector<std::size_t> ends{};
+
+        for (std::size_t begin = 0; begin < name.size() && name[begin] == '[';) {
+            auto close{name.find(']', begin)};
+            if (close == std::string_view::npos)
+                break;
+
+            ends.push_back(begin = close + 1);
+        }
+
+        return ends;
+    }
+
+    // Items with the most steps first, ties in name order
+    template<typename Item>
+    auto busiest(std::vector<std::pair<Item, std::uint64_t>>& items) -> void
+    {
+        std::ranges::sort(items, [](const auto& a, const auto& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+    }
+
+    auto append_row(std::string& out, std::uint64_t steps, std::uint64_t total, std::string_view name) -> void
+    {
+        auto share{total == 0 ? 0.0 : 100.0 * static_cast<double>(steps) / static_cast<double>(total)};
+        std::format_to(std::back_inserter(out), "{:>14} {:>6.2f}%  {}\n", steps, share, name);
+    }
+}
+
+auto execution_profile::merge(const execution_profile& other) -> void
+{
+    std::ranges::transform(counts, other.counts, counts.begin(), std::plus{});
+    runs += other.runs;
+}
+
+auto execution_profile::steps() const -> std::uint64_t
+{
+    return std::accumulate(counts.begin(), counts.end(), std::uint64_t{0});
+}
+
+auto execution_profile::state_steps(machine_definition::state_id state) const -> std::uint64_t
+{
+    auto row{counts.size() / definition->state_count()};
+    auto first{counts.begin() + static_cast<std::ptrdiff_t>(state * row)};
+    return std::accumulate(first, first + static_cast<std::ptrdiff_t>(row), std::uint64_t{0});
+}
+
+auto profile_run(execution& exec, execution_profile& profile, std::size_t max_steps)
+    -> std::pair<execution::status, std::size_t>
+{
+    const auto& definition{exec.machine()};
+    profile.count_run();
+
+    return step_until(exec, max_steps, [&](machine_definition::state_id state, char symbol) {
+        profile.count(definition.transition(state, symbol));
+    });
+}
+
+auto profile_batch(const machine_definition& definition, std::span<const std::string> inputs,
+    unsigned thread_count, std::size_t max_steps) -> execution_profile
+{
+    // One profile per worker, merged once they're done; the deque keeps each in place
+    std::deque<execution_profile> profiles{};
+    std::mutex adding{};
+
+    distribute(inputs.size(), thread_count, [&] {
+        std::lock_guard guard{adding};
+
+        return [&, exec = execution{definition}, counts = &profiles.emplace_back(definition)](std::size_t i) mutable {
+            exec.load_input(inputs[i]);
+            profile_run(exec, *counts, max_steps);
+        };
+    });
+
+    execution_profile total{definition};
+    for (const auto& counts : profiles)
+        total.merge(counts);
+
+    return total;
+}
+
+auto print_report(std::ostream& out, const execution_profile& profile) -> void
+{
+    const auto& definition{profile.machine()};
+    auto total{profile.steps()};
+
+    std::vector<std::pair<std::string_view, std::uint64_t>> components{};
+    std::vector<std::pair<std::string_view, std::uint64_t>> states{};
+    std::unordered_map<std::string_view, std::size_t> component_rows{};
+
+    for (machine_definition::state_id state = 0; state < definition.state_count(); ++state) {
+        auto steps{profile.state_steps(state)};
+        if (steps == 0)
+            continue;
+
+        auto name{definition.state_name(state)};
+        states.emplace_back(name, steps);
+
+        for (auto end : segment_ends(name)) {
+            auto [row, inserted] = component_rows.try_emplace(name.substr(0, end), components.size());
+            if (inserted)
+                components.emplace_back(name.substr(0, end), 0);
+
+            components[row->second].second += steps;
+        }
+    }
+
+    std::vector<std::pair<std::size_t, std::uint64_t>> transitions{};
+    for (std::size_t transition = 0; transition < definition.transition_count(); ++transition)
+        if (auto steps = profile.transition_steps(transition); steps != 0)
+            transitions.emplace_back(transition, steps);
+
+    busiest(components);
+    busiest(states);
+    busiest(transitions);
+
+    std::string report{};
+    std::format_to(std::back_inserter(report), "{} steps over {} runs\n", total, profile.run_count());
+
+    report.append("\nComponents\n");
+    for (const auto& [name, steps] : components)
+        append_row(report, steps, total, name);
+
+    report.append("\nStates\n");
+    for (const auto& [name, steps] : states | std::views::take(report_rows))
+        append_row(report, steps, total, name);
+
+    // Transitions are laid out [state][symbol code], code 0 being the unknown symbol
+    auto symbols{definition.alphabet()};
+    auto row{symbols.size() + 1};
+
+    report.append("\nTransitions\n");
+    for (const auto& [transition, steps] : transitions | std::views::take(report_rows)) {
+        auto state{static_cast<machine_definition::state_id>(transition / row)};
+        auto code{transition % row};
+
+        std::string name{definition.state_name(state)};
+        name.append(",").append(1, code == 0 ? '?' : symbols[code - 1]);
+        append_row(report, steps, total, name);
+    }
+
+    out << report;
+}
+
+auto print_folded(std::ostream& out, const execution_profile& profile) -> void
+{
+    const auto& definition{profile.machine()};
+    std::string folded{};
+
+    for (machine_definition::state_id state = 0; state < definition.state_count(); ++state) {
+        auto steps{profile.state_steps(state)};
+        if (steps == 0)
+            continue;
+
+        auto name{definition.state_name(state)};
+        std::size_t begin{0};
+
+        for (auto end : segment_ends(name)) {
+            folded.append(name.substr(begin + 1, end - begin - 2)).append(";");
+            begin = end;
+        }
+
+        std::format_to(std::back_inserter(folded), "{} {}\n", name.substr(begin), steps);
+    }
+
+    out << folded;
+}
@@ -0,0 +1,61 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include "machine.hpp"
+
+// Steps taken through each transition of a definition, over any number of runs. Only
+// profile_run() counts, so execution::step() and run() cost the same with or without
+// profiles. Counts are single steps, as step() takes them.
+class execution_profile {
+public:
+    explicit execution_profile(const machine_definition& definition)
+        : definition{&definition},
+          counts(definition.transition_count())
+    {
+    }
+
+    auto count(std::size_t transition) -> void { ++counts[transition]; }
+    auto count_run() -> void { ++runs; }
+
+    // Adds the counts of other, a profile of the same definition
+    auto merge(const execution_profile& other) -> void;
+
+    auto machine() const -> const machine_definition& { return *definition; }
+    auto run_count() const -> std::size_t { return runs; }
+    auto steps() const -> std::uint64_t;
+
+    // Steps taken from state, through any of its transitions
+    auto state_steps(machine_definition::state_id state) const -> std::uint64_t;
+    auto transition_steps(std::size_t transition) const -> std::uint64_t { return counts[transition]; }
+
+private:
+    const machine_definition* definition;
+    std::vector<std::uint64_t> counts;
+    std::size_t runs{0};
+};
+
+// Steps exec until it stops (or for max_steps), counting every step into profile
+auto profile_run(execution& exec, execution_profile& profile,
+    std::size_t max_steps = std::numeric_limits<std::size_t>::max()) -> std::pair<execution::status, std::size_t>;
+
+// Profiles every input on thread_count workers, each counting into its own profile
+auto profile_batch(const machine_definition& definition, std::span<const std::string> inputs,
+    unsigned thread_count, std::size_t max_steps = std::numeric_limits<std::size_t>::max()) -> execution_profile;
+
+// Steps per component (every [segment] prefix of the state names, inclusive of what it
+// contains), then the busiest states and transitions, each sorted by steps
+auto print_report(std::ostream& out, const execution_profile& profile) -> void;
+
+// One "segment;...;segment;state steps" line per state that took steps, the input format
+// of flame graph tools
+auto print_folded(std::ostream& out, const execution_profile& profile) -> void;
+
+#endif
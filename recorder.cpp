@@ -0,0 +1,250 @@
+#include "recorder.hpp"
+
+#include <array>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include "tape.hpp"
+
+namespace {
+    constexpr std::array<char, 8> trace_magic{'T', 'M', 'S', 'G', 'T', 'R', 'C', '\0'};
+    constexpr std::array<char, 8> trailer_magic{'T', 'M', 'S', 'G', 'E', 'N', 'D', '\0'};
+    constexpr std::uint32_t trace_version{2};
+    constexpr std::uint32_t byte_order_mark{0x01020304};
+    constexpr std::size_t record_alignment{alignof(std::uint64_t)};
+
+    // Start of every trace; the input follows, padded to record_alignment, then the records
+    struct trace_header {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint32_t state_count;
+        std::uint32_t initial;
+        std::uint64_t input_size;
+        std::uint64_t machine_fingerprint;
+    };
+
+    // End of a finished trace, after the last record
+    struct trace_trailer {
+        std::array<char, 8> magic;
+        std::uint64_t steps;
+        std::uint32_t final_state;
+        std::uint32_t final_status;
+    };
+
+    static_assert(std::is_trivially_copyable_v<trace_header> && sizeof(trace_header) % record_alignment == 0);
+    static_assert(std::is_trivially_copyable_v<trace_trailer> && sizeof(trace_trailer) % sizeof(step_record) == 0);
+
+    [[noreturn]] auto corrupt() -> void
+    {
+        throw std::runtime_error("Corrupt step trace");
+    }
+
+    auto padded(std::size_t size) -> std::size_t
+    {
+        return (size + record_alignment - 1) / record_alignment * record_alignment;
+    }
+}
+
+step_recorder::step_recorder(const std::filesystem::path& path, const machine_definition& definition,
+        std::string_view input)
+    : path{path},
+      out{path, std::ios::binary}
+{
+    trace_header header;
+    std::memset(&header, 0, sizeof header);
+
+    header.magic = trace_magic;
+    header.version = trace_version;
+    header.byte_order = byte_order_mark;
+    header.state_count = static_cast<std::uint32_t>(definition.state_count());
+    header.initial = definition.initial_state();
+    header.input_size = input.size();
+    header.machine_fingerprint = definition.fingerprint();
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+    out.write(input.data(), static_cast<std::streamsize>(input.size()));
+    out.write(std::string(padded(input.size()) - input.size(), '\0').data(),
+        static_cast<std::streamsize>(padded(input.size()) - input.size()));
+
+    if (!out)
+        throw std::runtime_error("Can't write step trace " + path.string());
+
+    writer = std::thread{[this] { drain(); }};
+}
+
+step_recorder::~step_recorder()
+{
+    close();
+}
+
+auto step_recorder::publish() -> void
+{
+    std::unique_lock guard{lock};
+    published = written;
+    changed.notify_all();
+
+    // Room for the next batch; only waits when the writer falls a whole ring behind
+    changed.wait(guard, [this] { return written + batch - drained <= capacity || failed; });
+}
+
+auto step_recorder::close() -> void
+{
+    if (!writer.joinable())
+        return;
+
+    {
+        std::lock_guard guard{lock};
+        published = written;
+        closing = true;
+    }
+
+    changed.notify_all();
+    writer.join();
+}
+
+auto step_recorder::drain() -> void
+{
+    std::unique_lock guard{lock};
+
+    for (;;) {
+        changed.wait(guard, [this] { return published != drained || closing; });
+        if (published == drained)
+            return;
+
+        auto begin{drained};
+        auto end{published};
+        guard.unlock();
+
+        // The producer doesn't touch [begin, end) until drained passes it
+        for (auto position = begin; position != end;) {
+            auto offset{position & (capacity - 1)};
+            auto count{std::min(end - position, capacity - offset)};
+
+            out.write(reinterpret_cast<const char*>(ring.get() + offset),
+                static_cast<std::streamsize>(count * sizeof(step_record)));
+            position += count;
+        }
+
+        guard.lock();
+        drained = end;
+        failed = failed || !out;
+        changed.notify_all();
+    }
+}
+
+auto step_recorder::finish(machine_definition::status final_status, machine_definition::state_id final_state) -> void
+{
+    close();
+
+    trace_trailer trailer{trailer_magic, written, final_state, static_cast<std::uint32_t>(final_status)};
+    out.write(reinterpret_cast<const char*>(&trailer), sizeof trailer);
+    out.flush();
+
+    if (failed || !out)
+        throw std::runtime_error("Can't write step trace " + path.string());
+}
+
+auto record_run(execution& exec, step_recorder& recorder, std::size_t max_steps)
+    -> std::pair<execution::status, std::size_t>
+{
+    const auto& definition{exec.machine()};
+
+    auto result{step_until(exec, max_steps, [&](machine_definition::state_id state, char read) {
+        const auto& reaction{definition.lookup(state, read)};
+        recorder.record({state, read, reaction.write, reaction.move});
+    })};
+
+    recorder.finish(result.first, exec.state());
+    return result;
+}
+
+auto recorded_trace::read(std::string_view data) -> recorded_trace
+{
+    if (data.size() < sizeof(trace_header) || std::memcmp(data.data(), trace_magic.data(), trace_magic.size()) != 0)
+        throw std::runtime_error("Not a step trace");
+
+    trace_header header;
+    std::memcpy(&header, data.data(), sizeof header);
+
+    if (header.version != trace_version || header.byte_order != byte_order_mark)
+        throw std::runtime_error("Unsupported step trace version or byte order");
+
+    if (header.initial >= header.state_count || header.input_size > data.size() - sizeof header)
+        corrupt();
+
+    recorded_trace trace{header.machine_fingerprint, header.state_count, header.initial,
+        data.substr(sizeof header, header.input_size), {}, {}};
+
+    auto records_begin{sizeof header + padded(header.input_size)};
+    auto records{data.substr(std::min(records_begin, data.size()))};
+
+    // An unfinished trace ends after its last whole record
+    auto count{records.size() / sizeof(step_record)};
+
+    if (records.size() >= sizeof(trace_trailer) && records.size() % sizeof(step_record) == 0) {
+        trace_trailer trailer;
+        std::memcpy(&trailer, records.data() + records.size() - sizeof trailer, sizeof trailer);
+
+        if (trailer.magic == trailer_magic && trailer.steps == (records.size() - sizeof trailer) / sizeof(step_record)) {
+            if (trailer.final_state >= header.state_count
+                    || trailer.final_status > static_cast<std::uint32_t>(machine_definition::status::running))
+                corrupt();
+
+            count = trailer.steps;
+            trace.end = {static_cast<machine_definition::status>(trailer.final_status), trailer.final_state};
+        }
+    }
+
+    trace.steps = {reinterpret_cast<const step_record*>(records.data()), count};
+    return trace;
+}
+
+auto print_trace(std::ostream& out, const machine_definition& definition, const recorded_trace& trace) -> void
+{
+    if (trace.machine_fingerprint != definition.fingerprint() || trace.state_count != definition.state_count())
+        throw std::runtime_error("Step trace was recorded on a different machine");
+
+    // Replaying the steps on the input checks every read symbol against the tape
+    tape_buffer cells{definition.blank()};
+    cells.load(trace.input);
+
+    std::string buffer{};
+    auto flush = [&] {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
+
+    for (std::size_t i = 0; i < trace.steps.size(); ++i) {
+        const auto& step{trace.steps[i]};
+        auto next{i + 1 < trace.steps.size() ? trace.steps[i + 1].state
+            : trace.end ? trace.end->final_state
+            : machine_definition::no_state};
+
+        if (step.state >= trace.state_count || (next != machine_definition::no_state && next >= trace.state_count)
+                || std::to_underlying(step.move) >= turing_machine::direction_specifiers.size()
+                || (i == 0 && step.state != trace.initial_state))
+            corrupt();
+
+        if (cells.symbol() != step.read)
+            throw std::runtime_error(std::format("Step trace doesn't match its input at step {}", i + 1));
+
+        cells.symbol() = step.write;
+        cells.move(turing_machine::head_offsets[std::to_underlying(step.move)]);
+
+        std::format_to(std::back_inserter(buffer), "{}: {},{} -> {},{},{}\n", i + 1,
+            definition.state_name(step.state), step.read,
+            next == machine_definition::no_state ? std::string_view{"?"} : definition.state_name(next),
+            step.write, turing_machine::direction_specifiers[std::to_underlying(step.move)]);
+
+        if (buffer.size() >= 1 << 20)
+            flush();
+    }
+
+    buffer.append(cells.contents()).append("\n");
+    buffer.append(trace.end ? turing_machine::status_message(trace.end->final_status) : std::string_view{"Step trace ends early"});
+    buffer.append("\n");
+    flush();
+}
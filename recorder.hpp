@@ -0,0 +1,109 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "machine.hpp"
+
+// One step of a recorded execution: the state it left and the reaction it took
+struct step_record {
+    machine_definition::state_id state;
+    char read;
+    char write;
+    machine_definition::direction move;
+    std::uint8_t reserved{};
+};
+
+static_assert(sizeof(step_record) == 8 && std::is_trivially_copyable_v<step_record>);
+
+// Writes a binary step trace: a header naming the machine (by its fingerprint), the initial
+// state and the input, the step records, and a trailer with the final status. record() only
+// copies the step into a ring buffer; a background thread drains it to the file in large
+// writes. Traces are only readable on machines with the byte order that wrote them.
+class step_recorder {
+public:
+    // Throws std::runtime_error when the file can't be created
+    step_recorder(const std::filesystem::path& path, const machine_definition& definition, std::string_view input);
+
+    // Stops the writer; a trace that wasn't finished has no trailer
+    ~step_recorder();
+
+    step_recorder(const step_recorder&) = delete;
+    auto operator=(const step_recorder&) -> step_recorder& = delete;
+
+    auto record(const step_record& step) -> void
+    {
+        ring[written & (capacity - 1)] = step;
+        if (++written % batch == 0) [[unlikely]]
+            publish();
+    }
+
+    // Writes the remaining steps and the trailer. Throws std::runtime_error on a write error.
+    auto finish(machine_definition::status final_status, machine_definition::state_id final_state) -> void;
+
+private:
+    static constexpr std::size_t capacity{1 << 16};
+    static constexpr std::size_t batch{1 << 14};
+
+    std::unique_ptr<step_record[]> ring{std::make_unique<step_record[]>(capacity)};
+    std::size_t written{0};
+
+    // Shared with the writer, which only wakes once per batch
+    std::mutex lock{};
+    std::condition_variable changed{};
+    std::size_t published{0};
+    std::size_t drained{0};
+    bool closing{false};
+    bool failed{false};
+
+    std::filesystem::path path;
+    std::ofstream out;
+    std::thread writer{};
+
+    auto publish() -> void;
+    auto close() -> void;
+    auto drain() -> void;
+};
+
+// Steps exec until it stops (or for max_steps), recording every step, then finishes recorder
+auto record_run(execution& exec, step_recorder& recorder,
+    std::size_t max_steps = std::numeric_limits<std::size_t>::max()) -> std::pair<execution::status, std::size_t>;
+
+// View of a trace file written by step_recorder
+struct recorded_trace {
+    struct ending {
+        machine_definition::status final_status;
+        machine_definition::state_id final_state;
+    };
+
+    std::uint64_t machine_fingerprint;
+    std::size_t state_count;
+    machine_definition::state_id initial_state;
+    std::string_view input;
+    std::span<const step_record> steps;
+
+    // Empty when the recording stopped before finish()
+    std::optional<ending> end;
+
+    // Throws std::runtime_error on a corrupt trace
+    static auto read(std::string_view data) -> recorded_trace;
+};
+
+// Prints one line per step using the state names of definition, which must be the
+// machine the trace was recorded on, then the final state, tape and status
+auto print_trace(std::ostream& out, const machine_definition& definition, const recorded_trace& trace) -> void;
+
+#endif
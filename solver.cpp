@@ -0,0 +1,368 @@
+#include "solver.hpp"
+
+#include <__ranges/repeat_view.h>
+#include <algorithm>
+#include <concepts>
+#include <format>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+namespace component {
+    using dir = turing_machine::direction;
+
+    auto _move(int amount, std::string_view name, dir direction)
+        -> turing_machine
+    {
+        auto build_transition = [direction](const auto idx) -> turing_machine::transition_entry
+        {
+            return {
+                 {std::to_string(idx), turing_machine::any_symbol},
+                {{std::to_string(idx+1), turing_machine::same_symbol}, direction}
+            };
+        };
+
+        turing_machine tm {};
+        tm.set_initial_state(std::to_string(0));
+        tm.set_accept_state(std::to_string(amount));
+
+        tm.add_transitions(
+            std::views::iota(0)
+            | std::views::take(amount)
+            | std::views::transform(build_transition)
+        );
+        
+        tm.set_title(name);
+        return tm;
+    }
+
+    auto move_right(int amount, std::string_view name)
+        -> turing_machine
+    {
+        return _move(amount, name, dir::right);
+    }
+
+    auto move_left(int amount, std::string_view name)
+        -> turing_machine
+    {
+        return _move(amount, name, dir::left);
+    }
+
+    auto find(char needle, std::string_view name, dir direction)
+        -> turing_machine
+    {
+        turing_machine tm {};
+        tm.set_initial_state("search");
+
+        // Keep searching on anything but the needle
+        tm.add_transition(
+            {"search", turing_machine::any_symbol},
+            {{"search", turing_machine::same_symbol}, direction}
+        );
+        tm.add_transition({"search", needle}, {{tm.accept_state(), needle}, dir::hold});
+        
+        tm.set_title(name);
+        return tm;
+    }
+
+    auto find_right(char needle, std::string_view name)
+        -> turing_machine
+    {
+        return find(needle, name, dir::right);
+    }
+
+    auto find_left(char needle, std::string_view name)
+        -> turing_machine
+    {
+        return find(needle, name, dir::left);
+    }
+
+    enum class repeater {
+        do_until,
+        do_while
+    };
+
+    auto repeat(const turing_machine& tm, repeater type, char symbol, std::string_view name)
+        -> turing_machine
+    {
+        // Start with prefixed renamed version of tm
+        auto repeater{turing_machine::concat(
+            turing_machine::list{tm}, name)
+        };
+
+        auto checker_state{"check"};
+        auto break_state{"break"};
+
+        // Redirect accept -> check
+        repeater.redirect_state(repeater.accept_state(), checker_state);
+
+        // Redirect check -> initial [do_until] or break out [do_while]
+        repeater.redirect_state(checker_state,
+            type == repeater::do_until ? repeater.initial_state()
+                : break_state
+        );
+
+        // ...but (check, needle) -> break out [do_until] or continue [do_while]
+        repeater.add_transition({checker_state, symbol}, {{
+            type == repeater::do_until ? break_state
+                : repeater.initial_state(),
+            symbol
+        }, dir::hold});
+        repeater.set_accept_state(break_state);
+
+        return repeater;
+    }
+
+    auto consume(char symbol, dir direction, std::string_view name)
+        -> turing_machine
+    {
+        turing_machine tm{};
+        tm.set_initial_state("consume");
+        tm.add_transition({tm.initial_state(), symbol}, {{tm.accept_state(), symbol}, direction});
+        tm.set_title(name);
+        return tm;
+    }
+
+    // One machine accepting any of sequences, read in direction with each symbol after the
+    // first found distances[n] cells past the previous one. Sequences sharing a prefix share
+    // its states, so the machine is a trie: deterministic by construction, and rejecting on
+    // the first symbol no sequence continues with. No sequence may be a prefix of another;
+    // throws std::logic_error when one is.
+    template<std::ranges::forward_range Q>
+    requires std::convertible_to<std::ranges::range_reference_t<Q>, int>
+    auto expect_any(const std::vector<std::vector<char>>& sequences, dir direction, Q distances,
+        std::string_view name)
+        -> turing_machine
+    {
+        turing_machine tm{};
+        tm.set_initial_state("start");
+
+        // Reads the symbol following prefix
+        auto reader = [](const std::string& prefix) -> state_name {
+            return prefix.empty() ? "start"s : prefix;
+        };
+
+        // A shared prefix adds its transitions again; a different reaction means a sequence
+        // ends where another goes on
+        turing_machine::transition_table transitions{};
+        auto add = [&](turing_machine::tape_state state, turing_machine::tape_reaction reaction) {
+            if (auto [it, inserted] = transitions.try_emplace(state, reaction); !inserted && it->second != reaction)
+                throw std::logic_error(std::format(
+                    "Conflicting transitions for ({}, {}) in {}", state.first.str(), state.second, name));
+        };
+
+        for (const auto& sequence : sequences) {
+            std::string prefix{};
+            auto distance{std::ranges::begin(distances)};
+
+            for (auto symbol : sequence) {
+                auto from{reader(prefix)};
+                prefix.push_back(symbol);
+
+                if (prefix.size() == sequence.size()) {
+                    add({from, symbol}, {{tm.accept_state(), symbol}, direction});
+                    break;
+                }
+
+                // Consuming the symbol moves one cell, the shifts after it the rest of the distance
+                auto shifts{*distance++ - 1};
+                auto shift = [&](int n) {
+                    return n == shifts ? reader(prefix) : state_name::prefixed(prefix, std::to_string(n));
+                };
+
+                add({from, symbol}, {{shift(0), symbol}, direction});
+                for (int n = 0; n < shifts; ++n)
+                    add(
+                        {shift(n), turing_machine::any_symbol},
+                        {{shift(n + 1), turing_machine::same_symbol}, direction}
+                    );
+            }
+        }
+
+        tm.add_transitions(transitions);
+        tm.set_title(name);
+        return tm;
+    }
+
+    constexpr auto permutations_sequence()
+        -> std::vector<std::vector<char>>
+    {
+        std::vector<char> set{'1', '2', '3', '4'};
+        std::vector<std::vector<char>> sequences{};
+        
+        do sequences.push_back(set);
+        while (std::ranges::next_permutation(set).found);
+
+        return sequences;
+    }
+
+    auto check_row(std::string_view name)
+        -> turing_machine
+    {
+        return expect_any(permutations_sequence(), dir::right, std::views::repeat(1), name);
+    }
+
+    auto check_rows(std::string_view name)
+        -> turing_machine
+    {
+        return turing_machine::concat(
+            turing_machine::list{
+                find_right(':', "move_to_row1:"),
+
+                repeat(turing_machine::concat(
+                    turing_machine::list{
+                        consume(':', dir::right, "pass:"),
+                        check_row("check_row"),
+                        move_right(4, "move_to_next")        
+                    }, "loop_body"
+                ), repeater::do_while, ':', "row_loop"),
+
+                find_left('_', "move_back"),
+                consume('_', dir::right, "move_to_start")
+            }, name
+        );
+    }
+
+    auto check_col(std::string_view name)
+        -> turing_machine
+    {
+        return expect_any(permutations_sequence(), dir::right, std::views::repeat(9), name);
+    }
+
+    auto check_cols(std::string_view name)
+        -> turing_machine
+    {
+        return turing_machine::concat(
+            turing_machine::list{
+                find_right(':', "move_to_col1:"),
+                consume(':', dir::right, "pass:"),
+
+                repeat(turing_machine::concat(
+                    turing_machine::list{
+                        check_col("check_col"),
+                        move_left(27, "move_to_next")        
+                    }, "loop_body"
+                ), repeater::do_until, ':', "col_loop"),
+
+                find_left('_', "move_back"),
+                consume('_', dir::right, "move_to_start")
+            }, name
+        );
+    }
+
+    constexpr auto tower_sequence()
+        -> std::vector<std::vector<char>>
+    {
+        std::vector<char> set{'1', '2', '3', '4'};
+        std::vector<std::vector<char>> sequences{};
+        
+        for (const auto tower : std::views::iota(1) | std::views::take(4)) {
+            do {
+                char max_height{0};
+                int towers_visible{0};
+                for (const auto height : set)
+                    if (height > max_height)
+                        max_height = height, towers_visible++;
+                
+                char tower_symbol{static_cast<char>('0' + tower)};
+
+                if (towers_visible == tower) {
+                    sequences.push_back({tower_symbol, set[0], set[1], set[2]});
+                }
+            } while (std::ranges::next_permutation(set).found);
+        }
+
+        return sequences;
+    }
+
+    enum class row_tower {
+        left,
+        right
+    };
+
+    auto tower_row(row_tower tower, std::string_view name)
+        -> turing_machine
+    {
+        auto expect_dir{tower == row_tower::left ? dir::right : dir::left};
+        return expect_any(tower_sequence(), expect_dir, std::vector{2, 1, 1}, name);
+    }
+
+    auto towers_rows(std::string_view name)
+        -> turing_machine
+    {
+        return turing_machine::concat(
+            turing_machine::list{
+                find_right(':', "move_to_tower1:"),
+
+                repeat(turing_machine::concat(
+                    turing_machine::list{
+                        move_left(1, "pass:"),
+                        tower_row(row_tower::left, "tower_left"),
+                        move_right(2, "move_to_right_tower"),
+                        tower_row(row_tower::right, "tower_right"),
+                        move_right(8, "move_to_next"),
+                    }, "loop_body"
+                ), repeater::do_while, ':', "tower_loop"),
+
+                find_left('_', "move_back"),
+                consume('_', dir::right, "move_to_start")
+            }, name
+        );
+    }
+
+    enum class col_tower {
+        down,
+        up
+    };
+
+    auto tower_col(col_tower tower, std::string_view name)
+        -> turing_machine
+    {
+        auto expect_dir{tower == col_tower::up ? dir::right : dir::left};
+        return expect_any(tower_sequence(), expect_dir, std::vector{7, 9, 9}, name);
+    }
+
+    auto towers_cols(std::string_view name)
+        -> turing_machine
+    {
+        return turing_machine::concat(
+            turing_machine::list{
+                repeat(turing_machine::concat(
+                    turing_machine::list{
+                        tower_col(col_tower::up, "tower_up"),
+                        move_right(15, "move_to_down"),
+                        tower_col(col_tower::down, "tower_down"),
+                        move_left(14, "move_to_next")
+                    }, "loop_body"
+                ), repeater::do_until, '#', "tower_loop"),
+
+                find_left('_', "move_back"),
+                consume('_', dir::right, "move_to_start")
+            }, name
+        );
+    }
+}
+
+auto solver_composition() -> turing_machine
+{
+    auto tm{turing_machine::concat(
+        turing_machine::list{
+            component::check_rows("check_rows"),
+            component::check_cols("check_cols"),
+            component::towers_rows("towers_rows"),
+            component::towers_cols("towers_cols")
+        }, "solver"
+    )};
+
+    tm.redirect_state(tm.accept_state(), "Y");
+    return tm;
+}
+
+auto solver() -> turing_machine
+{
+    return solver_composition().minimize();
+}
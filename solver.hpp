@@ -0,0 +1,13 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "turing.hpp"
+
+// Machine accepting exactly the valid 4x4 skyscraper grids: checks that rows and
+// columns are permutations, then the tower counts seen from each side
+auto solver_composition() -> turing_machine;
+
+// solver_composition(), minimized
+auto solver() -> turing_machine;
+
+#endif
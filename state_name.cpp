@@ -0,0 +1,174 @@
+#include "state_name.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <format>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+    constexpr std::uint32_t no_segment{std::numeric_limits<std::uint32_t>::max()};
+
+    // A flat name is (no_segment, string id); a prefixed one is (segment string id, inner name id)
+    struct name_node {
+        std::uint32_t segment;
+        std::uint32_t inner;
+    };
+
+    // Open-addressed (key -> id) table with linear probing: lookups touch one
+    // flat array instead of chasing a node per entry
+    class node_table {
+    public:
+        // The id stored for key, storing id first if key is new
+        auto try_emplace(std::uint64_t key, std::uint32_t id) -> std::pair<std::uint32_t, bool>
+        {
+            if (2 * (count + 1) > slots.size())
+                grow();
+
+            auto& slot{find(key)};
+            if (slot.id != empty)
+                return {slot.id, false};
+
+            slot = {key, id};
+            ++count;
+            return {id, true};
+        }
+
+    private:
+        static constexpr std::uint32_t empty{std::numeric_limits<std::uint32_t>::max()};
+
+        struct entry {
+            std::uint64_t key{};
+            std::uint32_t id{empty};
+        };
+
+        std::vector<entry> slots{};
+        std::size_t count{0};
+
+        auto find(std::uint64_t key) -> entry&
+        {
+            auto mask{slots.size() - 1};
+            auto index{static_cast<std::size_t>((key * 0x9e3779b97f4a7c15) >> 32) & mask};
+
+            while (slots[index].id != empty && slots[index].key != key)
+                index = (index + 1) & mask;
+
+            return slots[index];
+        }
+
+        auto grow() -> void
+        {
+            auto previous{std::exchange(slots, std::vector<entry>(std::max<std::size_t>(64, 2 * slots.size())))};
+            for (const auto& slot : previous)
+                if (slot.id != empty)
+                    find(slot.key) = slot;
+        }
+    };
+
+    struct name_pool {
+        // deque keeps the strings (and the views keying string_ids) in place as it grows
+        std::deque<std::string> strings{};
+        std::unordered_map<std::string_view, std::uint32_t> string_ids{};
+
+        std::vector<name_node> nodes{};
+        node_table node_ids{};
+
+        name_pool()
+        {
+            // The empty name is always handle 0
+            intern_node(no_segment, intern_string(""));
+        }
+
+        auto intern_string(std::string_view str) -> std::uint32_t
+        {
+            if (auto it = string_ids.find(str); it != string_ids.end())
+                return it->second;
+
+            auto id{static_cast<std::uint32_t>(strings.size())};
+            string_ids.emplace(strings.emplace_back(str), id);
+            return id;
+        }
+
+        auto intern_node(std::uint32_t segment, std::uint32_t inner) -> std::uint32_t
+        {
+            auto key{std::uint64_t{segment} << 32 | inner};
+            auto [id, inserted] = node_ids.try_emplace(key, static_cast<std::uint32_t>(nodes.size()));
+            if (inserted)
+                nodes.push_back({segment, inner});
+            return id;
+        }
+    };
+
+    auto pool() -> name_pool&
+    {
+        static name_pool instance{};
+        return instance;
+    }
+}
+
+state_name::state_name()
+    : handle{0}
+{
+}
+
+state_name::state_name(std::string_view name)
+{
+    if (name.starts_with('['))
+        if (auto close = name.find(']'); close != std::string_view::npos) {
+            *this = prefixed(name.substr(1, close - 1), state_name{name.substr(close + 1)});
+            return;
+        }
+
+    auto& names{pool()};
+    handle = names.intern_node(no_segment, names.intern_string(name));
+}
+
+auto state_name::prefixed(std::string_view segment, state_name inner) -> state_name
+{
+    // Text names end their segments at the first ']', so one inside would split differently on reading
+    if (segment.contains(']'))
+        throw std::logic_error(std::format("State name segment \"{}\" contains ']'", segment));
+
+    auto& names{pool()};
+    return state_name{names.intern_node(names.intern_string(segment), inner.handle)};
+}
+
+auto state_name::segment() const -> std::optional<std::string_view>
+{
+    auto& names{pool()};
+    auto node{names.nodes[handle]};
+
+    if (node.segment == no_segment)
+        return std::nullopt;
+
+    return names.strings[node.segment];
+}
+
+auto state_name::inner() const -> state_name
+{
+    auto node{pool().nodes[handle]};
+    return node.segment == no_segment ? *this : state_name{node.inner};
+}
+
+auto state_name::str() const -> std::string
+{
+    std::string result{};
+    append_to(result);
+    return result;
+}
+
+auto state_name::append_to(std::string& out) const -> void
+{
+    auto& names{pool()};
+    auto node{names.nodes[handle]};
+
+    while (node.segment != no_segment) {
+        out.append("[").append(names.strings[node.segment]).append("]");
+        node = names.nodes[node.inner];
+    }
+
+    out.append(names.strings[node.inner]);
+}
@@ -0,0 +1,58 @@
+#ifndef STATE_NAME_H
+#define STATE_NAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// 32-bit handle to a state name interned in a process-wide pool. Hierarchical
+// names such as "[solver][check_rows]search" are stored as (segment, inner name)
+// pairs, so prefixing a name interns one pair instead of building a longer
+// string, and comparing or hashing any name is O(1).
+//
+// Text names are split at their leading "[segment]" parts when interned, so a
+// name read from a file and the same name built by prefixing share a handle.
+// The pool is not synchronized: build machines on a single thread.
+class state_name {
+public:
+    using id_type = std::uint32_t;
+
+    // The empty name
+    state_name();
+
+    state_name(std::string_view name);
+    state_name(const std::string& name) : state_name{std::string_view{name}} {}
+    state_name(const char* name) : state_name{std::string_view{name}} {}
+
+    // The name "[segment]inner". Throws std::logic_error if segment contains ']'
+    static auto prefixed(std::string_view segment, state_name inner) -> state_name;
+
+    // Outermost segment and the name it prefixes, if this name is prefixed
+    auto segment() const -> std::optional<std::string_view>;
+    auto inner() const -> state_name;
+
+    auto str() const -> std::string;
+    auto append_to(std::string& out) const -> void;
+
+    auto id() const -> id_type { return handle; }
+
+    friend auto operator==(state_name, state_name) -> bool = default;
+
+private:
+    explicit state_name(id_type handle)
+        : handle{handle}
+    {
+    }
+
+    id_type handle;
+};
+
+template<>
+struct std::hash<state_name> {
+    auto operator()(state_name name) const noexcept -> std::size_t { return name.id(); }
+};
+
+#endif
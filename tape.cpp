@@ -0,0 +1,84 @@
+#include "tape.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr std::ptrdiff_t minimum_size{64};
+
+auto tape_buffer::load(std::string_view input) -> void
+{
+    auto length{std::max<std::ptrdiff_t>(std::ssize(input), 1)};
+    auto size{std::max({std::ssize(cells), 2 * length, minimum_size})};
+
+    // assign() keeps the previous allocation when it is large enough
+    cells.assign(static_cast<std::size_t>(size), blank);
+
+    used_begin = (size - length) / 2;
+    used_end = used_begin + length;
+    head = used_begin;
+
+    std::ranges::copy(input, cells.begin() + used_begin);
+}
+
+auto tape_buffer::distance_to(char needle, std::ptrdiff_t delta) const -> std::ptrdiff_t
+{
+    // memchr/memrchr are vectorized by the C library
+    if (delta > 0) {
+        const auto* from{cells.data() + head + 1};
+        const auto* found{static_cast<const char*>(std::memchr(from, needle,
+            static_cast<std::size_t>(used_end - head - 1)))};
+        return found ? found - from + 1 : used_end - head;
+    }
+
+    const auto* found{static_cast<const char*>(::memrchr(cells.data() + used_begin, needle,
+        static_cast<std::size_t>(head - used_begin)))};
+    return found ? cells.data() + head - found : head - used_begin + 1;
+}
+
+auto tape_buffer::distance_to(const std::array<bool, 256>& stops, std::ptrdiff_t delta) const
+    -> std::ptrdiff_t
+{
+    auto edge{delta > 0 ? used_end : used_begin - 1};
+
+    auto position{head + delta};
+    while (position != edge && !stops[static_cast<unsigned char>(cells[position])])
+        position += delta;
+
+    return (position - head) * delta;
+}
+
+auto tape_buffer::extend_left() -> void
+{
+    if (head < 0)
+        grow();
+
+    used_begin = head;
+}
+
+auto tape_buffer::extend_right() -> void
+{
+    if (head >= std::ssize(cells))
+        grow();
+
+    used_end = head + 1;
+}
+
+auto tape_buffer::grow() -> void
+{
+    auto first{std::min(used_begin, head)};
+    auto last{std::max(used_end, head + 1)};
+    auto span{last - first};
+
+    auto size{std::max(2 * std::ssize(cells), 2 * span)};
+    std::vector<char> grown(static_cast<std::size_t>(size), blank);
+
+    // Re-centre the visited region (and the head) in the new buffer
+    auto offset{(size - span) / 2 - first};
+    std::ranges::copy(cells.begin() + used_begin, cells.begin() + used_end,
+        grown.begin() + used_begin + offset);
+
+    cells = std::move(grown);
+    head += offset;
+    used_begin += offset;
+    used_end += offset;
+}
@@ -0,0 +1,66 @@
+#ifndef TAPE_H
+#define TAPE_H
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Single contiguous tape with blank slack on both sides of the visited region.
+// The head indexes the buffer directly; growth doubles the buffer and
+// re-centres the visited region, so moving off either end is amortized O(1).
+class tape_buffer {
+public:
+    explicit tape_buffer(char blank)
+        : blank{blank}
+    {
+    }
+
+    auto load(std::string_view input) -> void;
+
+    // Unchecked access to the cell under the head. move() may grow the buffer, which
+    // invalidates the reference, so write through it before moving.
+    auto symbol() -> char& { return cells[head]; }
+    auto symbol() const -> char { return cells[head]; }
+
+    auto move(std::ptrdiff_t delta) -> void
+    {
+        head += delta;
+
+        if (head < used_begin) [[unlikely]]
+            extend_left();
+        else if (head >= used_end) [[unlikely]]
+            extend_right();
+    }
+
+    // Cells from the head to the nearest cell in direction delta (-1 or 1) holding needle,
+    // or to the first cell past the visited region when none does. The head cell is skipped.
+    auto distance_to(char needle, std::ptrdiff_t delta) const -> std::ptrdiff_t;
+
+    // Same, stopping at any symbol flagged in stops
+    auto distance_to(const std::array<bool, 256>& stops, std::ptrdiff_t delta) const -> std::ptrdiff_t;
+
+    // Every cell visited so far, plus the input
+    auto contents() const -> std::string_view
+    {
+        return {cells.data() + used_begin, static_cast<std::size_t>(used_end - used_begin)};
+    }
+
+    auto head_position() const -> std::size_t
+    {
+        return static_cast<std::size_t>(head - used_begin);
+    }
+
+private:
+    std::vector<char> cells{};
+    std::ptrdiff_t head{0};
+    std::ptrdiff_t used_begin{0};
+    std::ptrdiff_t used_end{0};
+    char blank;
+
+    auto extend_left() -> void;
+    auto extend_right() -> void;
+    auto grow() -> void;
+};
+
+#endif
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_set>
+#include <vector>
+#include <unistd.h>
+#include "bench/corpus.hpp"
+#include "machine.hpp"
+#include "mapped_file.hpp"
+#include "solver.hpp"
+#include "turing.hpp"
+
+// Runs every registered engine side by side with a reference interpreter, on the
+// solver and on random machines, and fails on the first input where an engine's
+// final status, tape, head or step count differs from the reference's.
+
+using status = turing_machine::status;
+using dir = turing_machine::direction;
+
+// Noise can send the solver into endless loops, which the limits cut short
+constexpr std::size_t solver_step_limit{100'000};
+constexpr std::size_t random_machines{500};
+constexpr std::size_t random_inputs{40};
+constexpr std::size_t random_step_limit{20'000};
+
+// Where a run stopped; engines that don't report the head leave it empty
+struct outcome {
+    status final_status;
+    std::size_t steps;
+    std::string tape;
+    std::optional<std::size_t> head;
+};
+
+// turing_machine::step as it was before any engine work: a table lookup per step, and
+// a tape of two vectors growing away from cell 0, each by one blank when the head
+// moves past its end. Wildcards apply as turing.hpp describes.
+class reference_machine {
+public:
+    explicit reference_machine(const turing_machine& tm)
+        : tm{&tm}
+    {
+        alphabet.insert(turing_machine::blank_symbol);
+
+        for (const auto& [state, reaction] : tm) {
+            table.insert({state, reaction});
+
+            if (state.second != turing_machine::any_symbol)
+                alphabet.insert(state.second);
+            if (reaction.first.second != turing_machine::same_symbol)
+                alphabet.insert(reaction.first.second);
+        }
+    }
+
+    auto run(std::string_view input, std::size_t max_steps) -> outcome
+    {
+        current_state = tm->initial_state();
+        head_index = 0;
+        tape_left = {};
+
+        if (input.empty())
+            tape_right = {turing_machine::blank_symbol};
+        else
+            tape_right.assign(input.begin(), input.end());
+
+        auto [exec, steps] = step_until(*this, max_steps);
+        return {exec, steps, std::string{tape_left.rbegin(), tape_left.rend()} + std::string{tape_right.begin(),
+            tape_right.end()}, static_cast<std::size_t>(static_cast<std::ptrdiff_t>(tape_left.size()) + head_index)};
+    }
+
+    // The interface step_until() drives
+    auto state() const -> state_name { return current_state; }
+    auto symbol() -> char { return cell(); }
+
+    auto step() -> status
+    {
+        auto& current_symbol{cell()};
+
+        if (!alphabet.contains(current_symbol))
+            return status::reject;
+
+        auto found{table.find({current_state, current_symbol})};
+        if (found == table.end())
+            found = table.find({current_state, turing_machine::any_symbol});
+        if (found == table.end())
+            return status::reject;
+
+        auto [next, move] = found->second;
+
+        current_state = next.first;
+        head_index += move == dir::left ? -1 : move == dir::right ? 1 : 0;
+
+        if (next.second != turing_machine::same_symbol)
+            current_symbol = next.second;
+
+        if (head_index == static_cast<std::ptrdiff_t>(tape_right.size()))
+            tape_right.push_back(turing_machine::blank_symbol);
+
+        if (-head_index - 1 == static_cast<std::ptrdiff_t>(tape_left.size()))
+            tape_left.push_back(turing_machine::blank_symbol);
+
+        return current_state == tm->halting_state() ? status::halt
+            : current_state == tm->accept_state() ? status::accept
+            : status::running;
+    }
+
+private:
+    const turing_machine* tm;
+    turing_machine::transition_table table{};
+    std::unordered_set<char> alphabet{};
+
+    state_name current_state{};
+    std::ptrdiff_t head_index{0};
+    std::vector<char> tape_right{};
+    std::vector<char> tape_left{};
+
+    auto cell() -> char& { return head_index >= 0 ? tape_right.at(head_index) : tape_left.at(-head_index - 1); }
+};
+
+// An engine runs every input on a machine for at most max_steps steps. Inexact engines
+// may legitimately reject earlier, so only their final status is compared, and a run the
+// reference hasn't finished may only be rejected.
+struct engine {
+    std::string_view name;
+    std::function<std::vector<outcome>(const turing_machine&, std::span<const std::string>, std::size_t)> run;
+    bool exact{true};
+};
+
+auto run_each(const machine_definition& definition, std::span<const std::string> inputs, std::size_t max_steps,
+    bool stepped) -> std::vector<outcome>
+{
+    std::vector<outcome> outcomes{};
+    execution exec{definition};
+
+    for (const auto& input : inputs) {
+        exec.load_input(input);
+
+        if (stepped) {
+            auto [exec_status, steps] = step_until(exec, max_steps);
+            outcomes.push_back({exec_status, steps, std::string{exec.tape()}, exec.head_position()});
+        } else {
+            auto result{exec.run(max_steps)};
+            outcomes.push_back({result.final_status, result.steps, std::move(result.tape), exec.head_position()});
+        }
+    }
+
+    return outcomes;
+}
+
+auto engines() -> std::vector<engine>
+{
+    return {
+        {"step", [](const turing_machine& tm, std::span<const std::string> inputs, std::size_t max_steps) {
+            return run_each(machine_definition{tm}, inputs, max_steps, true);
+        }},
+        {"run", [](const turing_machine& tm, std::span<const std::string> inputs, std::size_t max_steps) {
+            return run_each(machine_definition{tm}, inputs, max_steps, false);
+        }},
+        {"batch", [](const turing_machine& tm, std::span<const std::string> inputs, std::size_t max_steps) {
+            std::vector<outcome> outcomes{};
+            for (auto& result : run_batch(machine_definition{tm}, inputs, 4, max_steps))
+                outcomes.push_back({result.final_status, result.steps, std::move(result.tape), std::nullopt});
+            return outcomes;
+        }},
+        {"image", [](const turing_machine& tm, std::span<const std::string> inputs, std::size_t max_steps) {
+            // A file of its own, so parallel runs don't collide; the mapping outlives its name
+            auto path{(std::filesystem::temp_directory_path() / "tmsg_differential_XXXXXX").string()};
+            auto fd{::mkstemp(path.data())};
+            if (fd < 0)
+                throw std::system_error{errno, std::generic_category(), "Can't create " + path};
+            ::close(fd);
+
+            machine_definition{tm}.save(path);
+            auto definition{machine_definition::open(mapped_file{path})};
+            std::filesystem::remove(path);
+
+            return run_each(definition, inputs, max_steps, false);
+        }},
+        {"minimized", [](const turing_machine& tm, std::span<const std::string> inputs, std::size_t max_steps) {
+            return run_each(machine_definition{tm.minimize()}, inputs, max_steps, false);
+        }},
+        {"early_reject", [](const turing_machine& tm, std::span<const std::string> inputs, std::size_t max_steps) {
+            return run_each(machine_definition{tm, {.early_reject = true}}, inputs, max_steps, false);
+        }, false},
+    };
+}
+
+auto describe(const outcome& result) -> std::string
+{
+    return std::format("{} after {} steps, head {}, tape \"{}\"", turing_machine::status_message(result.final_status),
+        result.steps, result.head ? std::to_string(*result.head) : "?", result.tape);
+}
+
+auto same(const outcome& expected, const outcome& actual, bool exact) -> bool
+{
+    if (!exact)
+        return expected.final_status == actual.final_status
+            || (expected.final_status == status::running && actual.final_status == status::reject);
+
+    return expected.final_status == actual.final_status && expected.steps == actual.steps
+        && expected.tape == actual.tape && (!actual.head || expected.head == actual.head);
+}
+
+// Fails with the first input an engine gets wrong, narrowed down to the first step
+// after which the engine and the reference disagree
+auto compare(const turing_machine& tm, std::string_view machine, std::span<const std::string> inputs,
+    std::size_t max_steps) -> void
+{
+    reference_machine reference{tm};
+
+    std::vector<outcome> expected{};
+    for (const auto& input : inputs)
+        expected.push_back(reference.run(input, max_steps));
+
+    for (const auto& candidate : engines()) {
+        auto actual{candidate.run(tm, inputs, max_steps)};
+
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            if (same(expected[i], actual[i], candidate.exact))
+                continue;
+
+            // Runs agree up to some step count and disagree from there; find the first
+            std::size_t agree{0};
+            std::size_t differ{expected[i].steps + 1};
+
+            if (candidate.exact) {
+                while (differ - agree > 1) {
+                    auto middle{agree + (differ - agree) / 2};
+                    auto limited{candidate.run(tm, std::span{&inputs[i], 1}, middle).front()};
+
+                    if (same(reference.run(inputs[i], middle), limited, true))
+                        agree = middle;
+                    else
+                        differ = middle;
+                }
+            }
+
+            std::cerr << std::format("{} diverges from the reference on {}, input \"{}\", at step {}\n"
+                "  reference: {}\n  {}: {}\n", candidate.name, machine, inputs[i], differ,
+                describe(reference.run(inputs[i], differ)), candidate.name,
+                describe(candidate.run(tm, std::span{&inputs[i], 1}, differ).front()));
+
+            std::exit(EXIT_FAILURE);
+        }
+    }
+}
+
+auto random_string(std::mt19937& random, std::string_view symbols, std::size_t max_length) -> std::string
+{
+    std::string text(std::uniform_int_distribution<std::size_t>{0, max_length}(random), '\0');
+    for (auto& symbol : text)
+        symbol = symbols[std::uniform_int_distribution<std::size_t>{0, symbols.size() - 1}(random)];
+
+    return text;
+}
+
+// Random machine over "ab_" with wildcard reads and writes, so that scans, fused
+// chains, dead states and symbols outside the alphabet all come up
+auto random_machine(std::mt19937& random) -> turing_machine
+{
+    constexpr std::string_view reads{"ab_*"};
+    constexpr std::string_view writes{"ab_*"};
+
+    auto states{std::uniform_int_distribution<int>{1, 8}(random)};
+    auto pick = [&](int count) { return std::uniform_int_distribution<int>{0, count - 1}(random); };
+
+    turing_machine tm{};
+    for (int state = 0; state < states; ++state)
+        for (auto read : reads) {
+            if (pick(4) == 0)
+                continue;
+
+            auto target{pick(states + 2)};
+            auto next{target == states ? std::string{"Y"} : target == states + 1 ? std::string{"H"}
+                : std::format("q{}", target)};
+
+            tm.add_transition({std::format("q{}", state), read},
+                {{next, writes[static_cast<std::size_t>(pick(4))]}, static_cast<dir>(pick(3))});
+        }
+
+    tm.set_initial_state("q0");
+    tm.set_accept_state("Y");
+    tm.set_title(std::format("random{}", states));
+    return tm;
+}
+
+int main()
+{
+    std::mt19937 random{20240601};
+
+    // The solver, before minimize() so that the minimized engine checks it, on the
+    // corpus, on corrupted grids and on noise
+    auto inputs{read_corpus("valid.txt")};
+    auto invalid{read_corpus("invalid.txt")};
+    inputs.insert(inputs.end(), invalid.begin(), invalid.end());
+
+    auto grids{inputs.size()};
+    for (std::size_t i = 0; i < grids; ++i) {
+        auto corrupted{inputs[i]};
+        corrupted[std::uniform_int_distribution<std::size_t>{0, corrupted.size() - 1}(random)]
+            = "1234:#_x"[std::uniform_int_distribution<std::size_t>{0, 7}(random)];
+        inputs.push_back(std::move(corrupted));
+        inputs.push_back(random_string(random, "1234:#_", 48));
+    }
+
+    inputs.push_back("");
+    compare(solver_composition(), "the solver", inputs, solver_step_limit);
+
+    for (std::size_t i = 0; i < random_machines; ++i) {
+        auto tm{random_machine(random)};
+
+        std::vector<std::string> machine_inputs{};
+        for (std::size_t j = 0; j < random_inputs; ++j)
+            machine_inputs.push_back(random_string(random, "ab_ab_c*", 12));
+
+        std::ostringstream text{};
+        tm.print(text, turing_machine::ordering::canonical);
+        compare(tm, std::format("random machine {}:\n{}", i, text.str()), machine_inputs, random_step_limit);
+    }
+
+    std::cout << std::format("{} engines agree with the reference on the solver and {} random machines\n",
+        engines().size(), random_machines);
+}
@@ -0,0 +1,57 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <format>
+#include <iterator>
+#include <utility>
+
+static constexpr std::string_view ansi_blue{"\033[1;34m"};
+static constexpr std::string_view ansi_reset{"\033[0m"};
+static constexpr std::size_t block_size{1 << 20};
+
+trace_renderer::trace_renderer(std::ostream& out, trace_options options)
+    : out{&out},
+      options{options}
+{
+    buffer.reserve(block_size);
+}
+
+trace_renderer::~trace_renderer()
+{
+    flush();
+}
+
+auto trace_renderer::frame(const execution& exec, std::size_t step, bool force) -> void
+{
+    auto changed{std::exchange(previous_state, exec.state()) != exec.state()};
+    if (!force && (options.state_changes ? !changed : step % options.every != 0))
+        return;
+
+    auto tape{exec.tape()};
+    auto position{exec.head_position()};
+
+    auto first{position - std::min(position, options.window)};
+    auto last{position + 1 + std::min(tape.size() - position - 1, options.window)};
+
+    buffer.append(position - first, '_').append(1, 'v').append(last - position - 1, '_');
+    buffer.append(" (").append(exec.machine().state_name(exec.state())).append(")");
+    if (first != 0 || last != tape.size())
+        std::format_to(std::back_inserter(buffer), " @{}", first);
+
+    buffer.append("\n").append(ansi_blue).append(tape.substr(first, last - first)).append(ansi_reset).append("\n\n");
+
+    if (buffer.size() >= block_size)
+        flush();
+}
+
+auto trace_renderer::line(std::string_view text) -> void
+{
+    buffer.append(text).append("\n");
+}
+
+auto trace_renderer::flush() -> void
+{
+    out->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out->flush();
+    buffer.clear();
+}
@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "machine.hpp"
+
+struct trace_options {
+    // Cells shown on each side of the head; the whole tape by default
+    std::size_t window{std::numeric_limits<std::size_t>::max()};
+
+    // Print every nth step, or only the steps that change state
+    std::size_t every{1};
+    bool state_changes{false};
+};
+
+// Prints execution frames (the head line and the tape) into one reused buffer,
+// written out in large blocks. With a window, each frame costs O(window) instead
+// of O(tape length), and the head line ends with the window's first cell.
+class trace_renderer {
+public:
+    trace_renderer(std::ostream& out, trace_options options);
+    ~trace_renderer();
+
+    trace_renderer(const trace_renderer&) = delete;
+    auto operator=(const trace_renderer&) -> trace_renderer& = delete;
+
+    // Renders exec as it is after step steps, if the sampling options select that
+    // step. The first and last frames of a trace should be forced.
+    auto frame(const execution& exec, std::size_t step, bool force = false) -> void;
+
+    auto line(std::string_view text) -> void;
+    auto flush() -> void;
+
+private:
+    std::ostream* out;
+    trace_options options;
+    std::string buffer{};
+    execution::state_id previous_state{machine_definition::no_state};
+};
+
+#endif
@@ -1,29 +1,37 @@
 #include "turing.hpp"
 
+#include <array>
+#include <format>
 #include <ranges>
 #include <istream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include "mapped_file.hpp"
 
 auto turing_machine::add_transition(tape_state state, tape_reaction reaction) -> void
 {
     transitions[state] = reaction;
 }
 
-auto turing_machine::redirect_state(std::string_view state_from, std::string_view state_to, const std::set<char>& alphabet)
-    -> void
+auto turing_machine::redirect_state(state_name state_from, state_name state_to) -> void
 {
-    for (auto symbol : alphabet)
-        add_transition(
-            {std::string{state_from}, symbol},
-            {{std::string{state_to}, symbol}, direction::hold}
-        );
+    add_transition(
+        {state_from, any_symbol},
+        {{state_to, same_symbol}, direction::hold}
+    );
 }
 
-auto turing_machine::set_initial_state(std::string_view name) -> void
+auto turing_machine::set_initial_state(state_name name) -> void
 {
     initial = name;
 }
 
-auto turing_machine::set_accept_state(std::string_view name) -> void
+auto turing_machine::set_accept_state(state_name name) -> void
 {
     accept = name;
 }
@@ -33,124 +41,311 @@ auto turing_machine::set_title(std::string_view title) -> void
     this->title = title;
 }
 
-
-auto turing_machine::load_input(std::string_view input) -> void
-{
-    current_state = initial;
-    head_index = 0;
-    tape_left = {};
-
-    if (input.empty())
-        tape_right = {blank_symbol};
-    else
-        tape_right = input | std::ranges::to<std::vector>();
-}
-
 static const std::unordered_map<std::string_view, turing_machine::direction> specifier_to_direction {
     {"<", turing_machine::direction::left},
     {">", turing_machine::direction::right},
     {"-", turing_machine::direction::hold}
 };
 
-auto direction_to_specifier = specifier_to_direction
-    | std::views::transform([](const auto& pair){ return std::pair{pair.second, pair.first}; })
-    | std::ranges::to<std::unordered_map<turing_machine::direction, std::string_view>>();
+namespace {
+    auto is_space(char c) -> bool
+    {
+        return std::string_view{" \t\n\v\r\f"}.contains(c);
+    }
+
+    auto trim(std::string_view str) -> std::string_view
+    {
+        while (!str.empty() && is_space(str.front()))
+            str.remove_prefix(1);
+        while (!str.empty() && is_space(str.back()))
+            str.remove_suffix(1);
+        return str;
+    }
+
+    // Lines of a text, viewed in place and numbered for error messages
+    class line_reader {
+    public:
+        explicit line_reader(std::string_view text)
+            : text{text}
+        {
+        }
+
+        auto next(std::string_view& line) -> bool
+        {
+            if (position >= text.size())
+                return false;
+
+            // Fields are taken from the ends of a line, so stray spaces and \r go first
+            auto end{std::min(text.find('\n', position), text.size())};
+            line = trim(text.substr(position, end - position));
+
+            position = end + 1;
+            ++number;
+            return true;
+        }
+
+        [[noreturn]] auto fail(std::string_view expected) const -> void
+        {
+            throw std::logic_error(std::format(
+                "Invalid format for Turing machine description (line {}: expected {})", number, expected));
+        }
+
+    private:
+        std::string_view text;
+        std::size_t position{0};
+        std::size_t number{0};
+    };
+
+    // Fields are split from the right, so state names may contain commas
+    auto parse_text(std::string_view text, turing_machine& tm) -> void
+    {
+        if (trim(text).empty())
+            throw std::logic_error("Invalid format for Turing machine description (empty)");
+
+        line_reader lines{text};
+        std::string_view line{};
+
+        auto header = [&](std::string_view key) -> state_name {
+            if (!lines.next(line))
+                lines.fail(key);
+
+            auto colon{line.find(':')};
+            if (colon == std::string_view::npos || trim(line.substr(0, colon)) != key)
+                lines.fail(key);
+
+            return trim(line.substr(colon + 1));
+        };
+
+        tm.set_initial_state(header("init"));
+        tm.set_accept_state(header("accept"));
+
+        while (lines.next(line)) {
+            if (line.empty() || line.starts_with("//"))
+                continue;
+
+            // state,symbol
+            if (line.size() < 2 || line[line.size() - 2] != ',')
+                lines.fail("state,symbol");
+
+            turing_machine::tape_state from{line.substr(0, line.size() - 2), line.back()};
 
-static auto split_line(std::string_view str, char s) {
-    auto str_size = [](const auto& str) { return static_cast<std::size_t>(std::ranges::distance(str)); };
-    auto subrange_to_str = [&](const auto& str) { return std::string_view{str.begin(), str_size(str)}; };
+            // state,symbol,direction
+            if (!lines.next(line) || line.size() < 4 || line[line.size() - 2] != ','
+                    || line[line.size() - 4] != ',')
+                lines.fail("state,symbol,direction");
 
-    return str
-        | std::ranges::views::split(s)
-        | std::ranges::views::transform(subrange_to_str)
-        | std::ranges::to<std::vector<std::string_view>>();
+            auto direction{specifier_to_direction.find(line.substr(line.size() - 1))};
+            if (direction == specifier_to_direction.end())
+                lines.fail("direction <, > or -");
+
+            tm.add_transition(from, {
+                {line.substr(0, line.size() - 4), line[line.size() - 3]},
+                direction->second
+            });
+        }
+    }
 }
 
-bool is_space(char p) noexcept
+auto turing_machine::parse(std::string_view text) -> turing_machine
 {
-    auto ne = [p](auto q) { return p != q; };
-    return !!(" \t\n\v\r\f" | std::views::drop_while(ne));
-};
+    turing_machine tm{};
+    parse_text(text, tm);
+    return tm;
+}
 
-static auto trim(std::string_view const str) -> std::string
+auto turing_machine::load(const std::filesystem::path& path) -> turing_machine
 {
-    return str
-        | std::views::drop_while(is_space)
-        | std::views::reverse
-        | std::views::drop_while(is_space)
-        | std::views::reverse
-        | std::ranges::to<std::string>();
+    mapped_file file{path};
+    return parse(file.view());
 }
 
 std::istream& operator>>(std::istream& in, turing_machine& tm)
 {
-    std::string line{};
+    std::string text{std::istreambuf_iterator<char>{in}, {}};
+    parse_text(text, tm);
+    return in;
+}
 
-    std::getline(in, line);
-    tm.set_initial_state(trim(split_line(line, ':')[1]));
+auto turing_machine::print(std::ostream& out, ordering order) const -> void
+{
+    std::vector<const transition_table::value_type*> entries{};
+    entries.reserve(transitions.size());
+    for (const auto& entry : transitions)
+        entries.push_back(&entry);
+
+    if (order == ordering::canonical) {
+        // Rank the distinct states by name once, then sort the transitions by integers.
+        // Handles are dense, so they index the ranks directly.
+        constexpr auto unranked{std::numeric_limits<std::uint32_t>::max()};
+        std::vector<std::uint32_t> ranks{};
+        std::vector<state_name> states{};
+
+        for (const auto* entry : entries) {
+            auto id{entry->first.first.id()};
+            if (id >= ranks.size())
+                ranks.resize(id + 1, unranked);
+
+            if (std::exchange(ranks[id], 0) == unranked)
+                states.push_back(entry->first.first);
+        }
 
-    std::getline(in, line);
-    tm.set_accept_state(trim(split_line(line, ':')[1]));
-    
-    while (std::getline(in, line)) {
-        if (line.size() == 0)
-            continue;
-        
-        if (line.starts_with("//"))
-            continue;
+        // All names in one arena, sorted as views into it
+        std::string arena{};
+        std::vector<std::size_t> ends{};
+        for (auto state : states) {
+            state.append_to(arena);
+            ends.push_back(arena.size());
+        }
 
-        auto values_from{split_line(line, ',')};
+        std::vector<std::pair<std::string_view, state_name>> names{};
+        names.reserve(states.size());
+        for (std::size_t i = 0, begin = 0; i < states.size(); begin = ends[i++])
+            names.emplace_back(std::string_view{arena}.substr(begin, ends[i] - begin), states[i]);
 
-        try {
-            auto state_from{values_from.at(0)};
-            auto symbol_from{values_from.at(1)[0]};   
+        std::ranges::sort(names, {}, &decltype(names)::value_type::first);
 
-            turing_machine::tape_state tape_state_from{state_from, symbol_from};
+        for (std::uint32_t rank = 0; rank < names.size(); ++rank)
+            ranks[names[rank].second.id()] = rank;
 
-            std::getline(in, line);
-            auto values_to{split_line(line, ',')};
+        std::vector<std::pair<std::uint64_t, const transition_table::value_type*>> keyed{};
+        keyed.reserve(entries.size());
+        for (const auto* entry : entries)
+            keyed.emplace_back(std::uint64_t{ranks[entry->first.first.id()]} << 8
+                | static_cast<unsigned char>(entry->first.second), entry);
 
-            auto state_to{values_to.at(0)};
-            auto symbol_to{values_to.at(1)[0]};
-            auto direction{specifier_to_direction.at(values_to.at(2))};
+        std::ranges::sort(keyed, {}, &decltype(keyed)::value_type::first);
+        std::ranges::copy(keyed | std::views::values, entries.begin());
+    }
 
-            turing_machine::tape_state tape_state_to{state_to, symbol_to};
-            turing_machine::tape_reaction reaction{tape_state_to, direction};
+    // Reused between calls; written out a chunk at a time, never flushed
+    constexpr std::size_t chunk_size{1 << 20};
+    thread_local std::string buffer{};
+    buffer.clear();
 
-            tm.add_transition(tape_state_from, reaction);
-        } catch (std::out_of_range const&) {
-            throw std::logic_error("Invalid format for Turing machine description");
-        }
+    auto write_chunk = [&] {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
+
+    buffer.append("init: ");
+    initial.append_to(buffer);
+    buffer.append("\naccept: ");
+    accept.append_to(buffer);
+    buffer.append("\n\n");
+
+    for (const auto* entry : entries) {
+        const auto& [state, reaction] = *entry;
+
+        state.first.append_to(buffer);
+        buffer.append({',', state.second, '\n'});
+        reaction.first.first.append_to(buffer);
+        buffer.append({',', reaction.first.second, ',', direction_specifiers[std::to_underlying(reaction.second)], '\n', '\n'});
+
+        if (buffer.size() >= chunk_size)
+            write_chunk();
     }
 
-    return in;
+    write_chunk();
 }
 
 std::ostream& operator<<(std::ostream& out, const turing_machine& tm)
 {
-    out << "init: " << tm.initial << std::endl
-        << "accept: " << tm.accept << std::endl << std::endl;
-
-    for (auto const& [key, val] : tm)
-        out << std::format("{},{}", key.first, key.second) << std::endl
-            << std::format("{},{},{}", val.first.first, val.first.second,
-                direction_to_specifier.at(val.second))
-            << std::endl << std::endl;
-
+    tm.print(out);
     return out;
 }
 
 auto turing_machine::prefix(std::string str) const
     -> turing_machine
 {
-    return transform_states([&](std::string_view s) {
-        return std::format("[{}]{}", str, s);
-    });
+    auto rename = [&](state_name name) { return state_name::prefixed(str, name); };
+
+    turing_machine result{};
+    result.transitions.reserve(transitions.size());
+
+    for (const auto& [state, reaction] : transitions)
+        result.transitions.try_emplace({rename(state.first), state.second},
+            tape_reaction{{rename(reaction.first.first), reaction.first.second}, reaction.second});
+
+    result.set_initial_state(rename(initial));
+    result.set_accept_state(rename(accept));
+    result.set_title(title);
+
+    return result;
 }
 
-auto turing_machine::prefixed() const -> turing_machine
+auto turing_machine::union_machines(std::vector<turing_machine>& machines, std::string_view title)
+    -> turing_machine
+{
+    if (machines.empty()) {
+        turing_machine result{};
+        result.set_title(title);
+        return result;
+    }
+
+    auto transition_count{std::ranges::fold_left(machines
+        | std::views::transform([](const auto& tm) { return tm.transitions.size(); }),
+        std::size_t{0}, std::plus{})};
+
+    auto result{std::move(machines.front())};
+    result.transitions.reserve(transition_count);
+
+    for (auto& tm : machines | std::views::drop(1)) {
+        result.transitions.merge(tm.transitions);
+
+        // merge() leaves behind the entries whose (state, symbol) was already present
+        for (const auto& [state, reaction] : tm.transitions)
+            if (result.transitions.at(state) != reaction)
+                throw std::logic_error(std::format(
+                    "Conflicting transitions for ({}, {}) in union {}",
+                    state.first.str(), state.second, title));
+    }
+
+    result.set_title(title);
+    return result;
+}
+
+auto turing_machine::concatenation::reserve(std::size_t transition_count) -> void
+{
+    result.transitions.reserve(transition_count);
+}
+
+auto turing_machine::concatenation::append(const turing_machine& tm) -> void
+{
+    auto rename = [&](state_name name) { return state_name::prefixed(tm.title, name); };
+    auto initial{rename(tm.initial)};
+
+    if (empty) {
+        result.initial = initial;
+        empty = false;
+    } else if (auto entering = by_target.extract(result.accept)) {
+        // Rewire everything that entered the previous accept state
+        for (auto reaction : entering.mapped())
+            reaction->first.first = initial;
+
+        auto& into_initial = by_target[initial];
+        into_initial.insert(into_initial.end(), entering.mapped().begin(), entering.mapped().end());
+    }
+
+    for (const auto& [state, reaction] : tm.transitions) {
+        // Like merge(), the first transition for a (state, symbol) wins
+        auto [it, inserted] = result.transitions.try_emplace(
+            {rename(state.first), state.second},
+            tape_reaction{{rename(reaction.first.first), reaction.first.second},
+                reaction.second}
+        );
+
+        // Element references are stable in unordered_map, even across rehashing
+        if (inserted)
+            by_target[it->second.first.first].push_back(&it->second);
+    }
+
+    result.accept = rename(tm.accept);
+}
+
+auto turing_machine::concatenation::finish(std::string_view title) && -> turing_machine
 {
-    return prefix(title);
+    result.set_title(title);
+    return std::move(result);
 }
 
 auto turing_machine::transform_states(std::function<std::string(std::string_view)> callback) const
@@ -159,77 +354,161 @@ auto turing_machine::transform_states(std::function<std::string(std::string_view
     turing_machine::transition_table result_transitions{};
 
     for (const auto& [state, reaction] : transitions) {
-        result_transitions[{callback(state.first), state.second}]
-            = {{callback(reaction.first.first), reaction.first.second}, reaction.second};
+        result_transitions[{callback(state.first.str()), state.second}]
+            = {{callback(reaction.first.first.str()), reaction.first.second}, reaction.second};
     }
 
     turing_machine result{result_transitions};
-    result.set_initial_state(callback(initial));
-    result.set_accept_state(callback(accept));
+    result.set_initial_state(callback(initial.str()));
+    result.set_accept_state(callback(accept.str()));
     result.set_title(title);
 
     return result;
 }
 
-auto turing_machine::step() -> status {
-    const std::unordered_map<direction, std::ptrdiff_t> index_diff {
-        {direction::left, -1},
-        {direction::right, 1},
-        {direction::hold,  0}
-    };
+auto turing_machine::minimize() const -> turing_machine
+{
+    std::unordered_map<state_name, std::vector<const transition_table::value_type*>> outgoing{};
+    std::vector<char> alphabet{blank_symbol};
 
-    auto& current_symbol{
-        head_index >= 0 ? tape_right.at(head_index)
-            : tape_left[-head_index - 1]
+    for (const auto& transition : transitions) {
+        const auto& [state, reaction] = transition;
+        outgoing[state.first].push_back(&transition);
+
+        if (state.second != any_symbol)
+            alphabet.push_back(state.second);
+        if (reaction.first.second != same_symbol)
+            alphabet.push_back(reaction.first.second);
+    }
+
+    std::ranges::sort(alphabet);
+    alphabet.erase(std::ranges::unique(alphabet).begin(), alphabet.end());
+
+    // Reachable states in breadth-first order from the initial state, so the
+    // choice of each merged state's representative below is deterministic
+    std::unordered_map<state_name, std::size_t> ids{{initial, 0}};
+    std::vector<state_name> states{initial};
+
+    for (std::size_t i = 0; i < states.size(); ++i) {
+        auto& edges{outgoing[states[i]]};
+        std::ranges::sort(edges, {}, [](const auto* transition) { return transition->first.second; });
+
+        for (const auto* transition : edges)
+            if (ids.try_emplace(transition->second.first.first, states.size()).second)
+                states.push_back(transition->second.first.first);
+    }
+
+    // Reaction of each state to each alphabet symbol, with wildcards resolved
+    constexpr std::size_t no_reaction{std::numeric_limits<std::size_t>::max()};
+    struct resolved {
+        std::size_t next{no_reaction};
+        char write{};
+        direction move{};
     };
 
-    tape_state state_from{current_state, current_symbol};
-    if (!transitions.contains(state_from))
-        return status::reject;
+    std::vector<resolved> reactions(states.size() * alphabet.size());
+
+    for (std::size_t id = 0; id < states.size(); ++id)
+        for (std::size_t code = 0; code < alphabet.size(); ++code) {
+            auto it{transitions.find({states[id], alphabet[code]})};
+            if (it == transitions.end())
+                it = transitions.find({states[id], any_symbol});
+            if (it == transitions.end())
+                continue;
+
+            auto [next, write] = it->second.first;
+            reactions[id * alphabet.size() + code] = {
+                ids.at(next),
+                write == same_symbol ? alphabet[code] : write,
+                it->second.second
+            };
+        }
 
-    auto reaction = transitions.at(state_from);
+    // Partition refinement: start with the accept and halt states apart from the
+    // rest, then split blocks whose states react differently (or move into
+    // different blocks) until no block splits. States left sharing a block
+    // behave identically on every tape.
+    std::vector<std::size_t> block(states.size());
+    for (std::size_t id = 0; id < states.size(); ++id)
+        block[id] = states[id] == accept ? 1 : states[id] == halt_state ? 2 : 0;
 
-    current_state = reaction.first.first;
-    head_index += index_diff.at(reaction.second);
+    for (std::size_t block_count = 0;;) {
+        std::map<std::vector<std::size_t>, std::size_t> signatures{};
+        std::vector<std::size_t> refined(states.size());
 
-    // Change symbol at head position on tape (current_symbol is reference)
-    current_symbol = reaction.first.second;
+        for (std::size_t id = 0; id < states.size(); ++id) {
+            std::vector<std::size_t> signature{block[id]};
 
-    if (head_index == static_cast<std::ptrdiff_t>(tape_right.size()))
-        tape_right.push_back(blank_symbol);
-    
-    if (-head_index - 1 == static_cast<std::ptrdiff_t>(tape_left.size()))
-        tape_left.push_back(blank_symbol);
-    
-    return current_state == halt_state ? status::halt
-        : current_state == accept ? status::accept
-        : status::running;
-}
+            for (const auto& reaction : std::span{reactions}.subspan(id * alphabet.size(), alphabet.size())) {
+                signature.push_back(reaction.next == no_reaction ? no_reaction : block[reaction.next]);
+                signature.push_back(static_cast<unsigned char>(reaction.write));
+                signature.push_back(std::to_underlying(reaction.move));
+            }
 
-auto turing_machine::tape() const -> std::string {
-    return std::string{tape_left.rbegin(), tape_left.rend()}
-         + std::string{tape_right.begin(), tape_right.end()};
-}
+            refined[id] = signatures.try_emplace(std::move(signature), signatures.size()).first->second;
+        }
+
+        block = std::move(refined);
+        if (std::exchange(block_count, signatures.size()) == signatures.size())
+            break;
+    }
 
-auto turing_machine::head() const -> std::string {
-    auto left_size = tape_left.size();
-    auto right_size = tape_right.size();
+    // The first state of each block in breadth-first order stands for the block,
+    // keeping the initial state's name
+    std::vector<std::optional<state_name>> representative(states.size());
+    for (std::size_t id = 0; id < states.size(); ++id)
+        if (!representative[block[id]])
+            representative[block[id]] = states[id];
 
-    return std::string(left_size + head_index, '_') + 'v'
-        + std::string(right_size - head_index - 1, '_')
-        + " (" + current_state + ')';
+    turing_machine result{*this};
+    result.transitions.clear();
+
+    for (std::size_t id = 0; id < states.size(); ++id) {
+        if (*representative[block[id]] != states[id])
+            continue;
+
+        for (const auto* transition : outgoing[states[id]]) {
+            auto [next, write] = transition->second.first;
+            result.transitions.try_emplace(transition->first,
+                tape_reaction{{*representative[block[ids.at(next)]], write}, transition->second.second});
+        }
+    }
+
+    // Symbols only dropped states used would leave the alphabet, and wildcard reads would
+    // stop applying to them; spelling those reads out keeps the symbols in
+    std::vector<char> kept{blank_symbol};
+    for (const auto& [state, reaction] : result.transitions) {
+        kept.push_back(state.second);
+        kept.push_back(reaction.first.second);
+    }
+
+    std::vector<tape_state> wildcards{};
+    for (const auto& [state, reaction] : result.transitions)
+        if (state.second == any_symbol)
+            wildcards.push_back(state);
+
+    for (auto symbol : alphabet)
+        if (std::ranges::find(kept, symbol) == kept.end())
+            for (const auto& wildcard : wildcards) {
+                auto reaction{result.transitions.at(wildcard)};
+                result.transitions.try_emplace({wildcard.first, symbol}, reaction);
+            }
+
+    return result;
 }
 
+// Indexed by turing_machine::status
+static constexpr std::array<std::string_view, 4> status_messages{
+    "Machine accepted.",
+    "Machine rejected.",
+    "Machine halted.",
+    "Machine still running."
+};
+
 auto turing_machine::status_message(status exec) -> std::string_view {
-    return std::unordered_map<status, std::string_view> {
-        {status::accept, "Machine accepted."},
-        {status::reject, "Machine rejected."},
-        {status::halt, "Machine halted."}
-    }.at(exec);
+    return status_messages[std::to_underlying(exec)];
 }
 
 auto turing_machine::tape_state_hash::operator()(const tape_state& state) const -> std::size_t {
-    auto h1 = std::hash<std::string>()(state.first);
-    auto h2 = std::hash<char>()(state.second);
-    return h1 ^ (h2 << 1);
+    return std::size_t{state.first.id()} << 8 | static_cast<unsigned char>(state.second);
 }
@@ -2,6 +2,9 @@
 #define TURING_H
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <filesystem>
 #include <functional>
 #include <string_view>
 #include <concepts>
@@ -11,23 +14,39 @@
 #include <utility>
 #include <ranges>
 #include <list>
-#include <set>
+#include <cstdint>
+#include "state_name.hpp"
 
 class turing_machine {
 public:
-    using tape_state = std::pair<std::string, char>;
+    using tape_state = std::pair<state_name, char>;
 
     // Stupid hash map needs a hash function for some reason...
     struct tape_state_hash {
         auto operator()(const tape_state& state) const -> std::size_t;
     };
 
-    enum class direction {
+    enum class direction : std::uint8_t {
         left,
         right,
         hold
     };
 
+    // Indexed by direction: how the text format spells it, and how far it moves the head
+    static constexpr std::array<char, 3> direction_specifiers{'<', '>', '-'};
+    static constexpr std::array<std::ptrdiff_t, 3> head_offsets{-1, 1, 0};
+
+    // Wildcards: a transition read on any_symbol applies to every symbol of the machine's
+    // alphabet that has no transition of its own, and writing same_symbol leaves the symbol
+    // read in place. The alphabet is every symbol read or written explicitly, plus the blank.
+    // There is no exclusion form: "any symbol except X" is a wildcard plus a transition for
+    // X, so rejecting on X takes a step into a state with no transitions. '*' is reserved,
+    // never a tape symbol; machine files that used it as one now read it as the wildcard.
+    static constexpr char any_symbol{'*'};
+    static constexpr char same_symbol{'*'};
+
+    static constexpr char blank_symbol{'_'};
+
     using tape_reaction = std::pair<tape_state, direction>;
     using transition_entry = std::pair<tape_state, tape_reaction>;
     using transition_table = std::unordered_map<tape_state, tape_reaction, tape_state_hash>;
@@ -70,19 +89,17 @@ public:
     auto begin() const -> transition_table::const_iterator { return transitions.begin(); }
     auto end() const -> transition_table::const_iterator { return transitions.end(); }
 
-    auto redirect_state(std::string_view state_from, std::string_view state_to, const std::set<char>& alphabet)
-        -> void;
-    auto set_initial_state(std::string_view name) -> void;
-    auto set_accept_state(std::string_view name) -> void;
+    auto redirect_state(state_name state_from, state_name state_to) -> void;
+    auto set_initial_state(state_name name) -> void;
+    auto set_accept_state(state_name name) -> void;
     auto set_title(std::string_view title) -> void;
 
-    auto load_input(std::string_view input) -> void;
-    auto step() -> status;
-    
-    auto tape() const -> std::string;
-    auto head() const -> std::string;
-    
     static auto status_message(status exec) -> std::string_view;
+
+    // Reads the text format operator<< writes, without copying the text. Throws
+    // std::logic_error naming the offending line; load() memory-maps the file.
+    static auto parse(std::string_view text) -> turing_machine;
+    static auto load(const std::filesystem::path& path) -> turing_machine;
     
     template<std::ranges::forward_range R>
     requires std::convertible_to<std::ranges::range_reference_t<R>, turing_machine>
@@ -90,30 +107,7 @@ public:
         R tms,
         std::string_view title
     )
-        -> turing_machine
-    {
-        // Get first Turing machine (prefixed)
-        auto initial = (*tms.begin()).prefixed();
-        
-        auto result = std::ranges::fold_left(tms | std::views::drop(1), initial,
-            [&](const turing_machine& first, const turing_machine& second)
-        {
-            auto result{first};
-            auto prefixed_second = second.prefixed();
-
-            for (auto& [state, reaction] : result.transitions)
-                if (reaction.first.first == result.accept)
-                    reaction.first.first = prefixed_second.initial;
-
-            result.add_transitions(prefixed_second.transitions);
-            result.set_accept_state(prefixed_second.accept);
-
-            return result;
-        });
-
-        result.set_title(title);
-        return result;
-    }
+        -> turing_machine;
 
     template<std::ranges::forward_range R>
     requires std::convertible_to<std::ranges::range_reference_t<R>, turing_machine>
@@ -121,21 +115,7 @@ public:
         R tms,
         std::string_view title
     )
-        -> turing_machine
-    {
-        auto initial = *tms.begin();
-        
-        auto result = std::ranges::fold_left(tms | std::views::drop(1), initial,
-            [&](const turing_machine& first, const turing_machine& second)
-        {
-            auto result{first};
-            result.add_transitions(second.transitions);
-            return result;
-        });
-
-        result.set_title(title);
-        return result;
-    }
+        -> turing_machine;
 
     auto transform_states(std::function<std::string(std::string_view)> callback) const
         -> turing_machine;
@@ -143,29 +123,106 @@ public:
     auto prefix(std::string str) const
         -> turing_machine;
 
-    auto initial_state() const -> std::string { return initial; }
-    auto accept_state() const -> std::string { return accept; }
+    // Equivalent machine without the states the initial state can't reach, and with
+    // states that behave identically on every tape merged into one. Step counts are kept.
+    auto minimize() const
+        -> turing_machine;
+
+    enum class ordering {
+        table,
+        canonical
+    };
+
+    // Writes the text format in one buffered pass. table order is the hash table's, which
+    // changes between builds; canonical sorts by state name, then symbol, so equal
+    // machines always print identically. operator<< uses table order.
+    auto print(std::ostream& out, ordering order = ordering::table) const -> void;
+
+    auto initial_state() const -> state_name { return initial; }
+    auto accept_state() const -> state_name { return accept; }
+    auto halting_state() const -> state_name { return halt_state; }
 
 private:
     transition_table transitions{};
 
-    std::string initial{"qStart"};
-    std::string halt_state{"H"};
-    std::string accept{"Y"};
+    state_name initial{"qStart"};
+    state_name halt_state{"H"};
+    state_name accept{"Y"};
     std::string title{"MyMachine"};
 
-    static constexpr char blank_symbol{'_'};
-
-    std::vector<char> tape_right{};
-    std::vector<char> tape_left{};
-    std::ptrdiff_t head_index{0};
-    std::string current_state{initial};
+    class concatenation;
 
-    auto prefixed() const -> turing_machine;
+    static auto union_machines(std::vector<turing_machine>& machines, std::string_view title)
+        -> turing_machine;
 
+    friend class machine_definition;
     friend std::ostream& operator<<(std::ostream& out, const turing_machine& tm);
 };
 
+// Composes machines end to end in one pass for concat(). Every composed transition is
+// indexed by its target state, so rewiring the previous accept state into the next
+// machine's initial state only touches the transitions that enter it.
+class turing_machine::concatenation {
+public:
+    auto reserve(std::size_t transition_count) -> void;
+    auto append(const turing_machine& tm) -> void;
+    auto finish(std::string_view title) && -> turing_machine;
+
+private:
+    turing_machine result{};
+    std::unordered_map<state_name, std::vector<tape_reaction*>> by_target{};
+    bool empty{true};
+};
+
+template<std::ranges::forward_range R>
+requires std::convertible_to<std::ranges::range_reference_t<R>, turing_machine>
+auto turing_machine::concat(
+    R tms,
+    std::string_view title
+)
+    -> turing_machine
+{
+    concatenation builder{};
+
+    // Sizes can only be summed up front when the range doesn't build its machines on the fly
+    if constexpr (std::is_lvalue_reference_v<std::ranges::range_reference_t<R>>) {
+        std::size_t transition_count{0};
+        for (const turing_machine& tm : tms)
+            transition_count += tm.transitions.size();
+
+        builder.reserve(transition_count);
+    }
+
+    for (const turing_machine& tm : tms)
+        builder.append(tm);
+
+    return std::move(builder).finish(title);
+}
+
+template<std::ranges::forward_range R>
+requires std::convertible_to<std::ranges::range_reference_t<R>, turing_machine>
+auto turing_machine::union_all(
+    R tms,
+    std::string_view title
+)
+    -> turing_machine
+{
+    // Owned machines let union_machines() move transition nodes over instead of copying them.
+    // tms is a copy, so a container's machines are ours to move; a view's may be the caller's.
+    std::vector<turing_machine> machines{};
+    if constexpr (std::ranges::sized_range<R>)
+        machines.reserve(std::ranges::size(tms));
+
+    for (auto&& tm : tms) {
+        if constexpr (std::ranges::view<R>)
+            machines.emplace_back(std::forward<decltype(tm)>(tm));
+        else
+            machines.emplace_back(std::move(tm));
+    }
+
+    return union_machines(machines, title);
+}
+
 std::istream& operator>>(std::istream& in, turing_machine& tm);
 std::ostream& operator<<(std::ostream& out, const turing_machine& tm);
 